@@ -0,0 +1,196 @@
+#include <chrono>
+
+#include "collisionmesh.h"
+#include "playground.h"
+#include "physicsworld.h"
+#include "precisionmesh.h"
+
+// Simulated frames per measurement
+#define BENCH_STEPS 600
+
+//------------------------------------------------------------------
+// Name: bench_physics_world
+// Desc: Drops a grid of bodies onto the terrain and reports the
+//       throughput of PhysicsWorld::Step in bodies/step
+//------------------------------------------------------------------
+static void bench_physics_world(const CollisionMesh *terrain, unsigned int num_bodies) {
+    PhysicsWorld world;
+    
+    vec3 extent = terrain->bounds_max - terrain->bounds_min;
+    unsigned int side = (unsigned int)ceilf(sqrtf((float)num_bodies));
+    
+    for(unsigned int i = 0; i < num_bodies; i++) {
+        float u = ((i % side) + 0.5f) / side;
+        float v = ((i / side) + 0.5f) / side;
+        
+        vec3 pos = terrain->bounds_min + vec3(extent.x * u, extent.y + 2.0f, extent.z * v);
+        world.AddBody(pos, 0.5f, 1.0f);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    unsigned long long pairs = 0;
+    unsigned long long cache_hits = 0;
+    
+    for(int step = 0; step < BENCH_STEPS; step++) {
+        world.Step(terrain);
+        pairs += world.num_broadphase_pairs;
+        cache_hits += world.num_terrain_cache_hits;
+    }
+    
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    
+    printf("physics_world  bodies=%5u  %9.3f ms/step  %12.0f body-steps/s  %6.1f pairs/step  %5.1f%% cached\n",
+        num_bodies,
+        seconds * 1000.0 / BENCH_STEPS,
+        (double)num_bodies * BENCH_STEPS / seconds,
+        (double)pairs / BENCH_STEPS,
+        100.0 * cache_hits / ((double)num_bodies * BENCH_STEPS)
+        );
+}
+
+//------------------------------------------------------------------
+// Name: bench_ray_queries
+// Desc: Casts a coherent grid of camera-style rays at the terrain,
+//       one at a time and as packets, and reports rays/s for each
+//------------------------------------------------------------------
+static void bench_ray_queries(const CollisionMesh *terrain) {
+    const unsigned int grid = 128;
+    const unsigned int num_rays = grid * grid;
+    
+    std::vector<vec3> origins(num_rays);
+    std::vector<vec3> directions(num_rays);
+    std::vector<RayHit> hits(num_rays);
+    
+    vec3 center = (terrain->bounds_min + terrain->bounds_max) * 0.5f;
+    vec3 eye = vec3(center.x, terrain->bounds_max.y + 10.0f, terrain->bounds_max.z + 10.0f);
+    
+    for(unsigned int i = 0; i < num_rays; i++) {
+        float u = ((i % grid) + 0.5f) / grid * 2.0f - 1.0f;
+        float v = ((i / grid) + 0.5f) / grid * 2.0f - 1.0f;
+        
+        origins[i] = eye;
+        directions[i] = normalize(center + vec3(u * 20.0f, v * 10.0f, 0.0f) - eye);
+    }
+    
+    float max_t = 1000.0f;
+    
+    // Single closest-hit rays
+    auto start = std::chrono::steady_clock::now();
+    unsigned int num_hits = 0;
+    
+    for(unsigned int i = 0; i < num_rays; i++)
+        num_hits += terrain->RayCast(hits[i], origins[i], directions[i], max_t);
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("ray_closest    rays=%6u  %12.0f rays/s  hits=%u\n", num_rays, num_rays / seconds, num_hits);
+    
+    // Any-hit rays
+    start = std::chrono::steady_clock::now();
+    num_hits = 0;
+    
+    for(unsigned int i = 0; i < num_rays; i++)
+        num_hits += terrain->RayCastAny(origins[i], directions[i], max_t);
+    
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("ray_any        rays=%6u  %12.0f rays/s  hits=%u\n", num_rays, num_rays / seconds, num_hits);
+    
+    // Packets of coherent closest-hit rays
+    start = std::chrono::steady_clock::now();
+    num_hits = 0;
+    
+    terrain->RayCastPacket(hits.data(), origins.data(), directions.data(), max_t, num_rays);
+    
+    for(unsigned int i = 0; i < num_rays; i++)
+        num_hits += hits[i].triangle != COLLISION_NO_TRIANGLE;
+    
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("ray_packet     rays=%6u  %12.0f rays/s  hits=%u\n", num_rays, num_rays / seconds, num_hits);
+    
+    // Sphere casts
+    start = std::chrono::steady_clock::now();
+    num_hits = 0;
+    
+    for(unsigned int i = 0; i < num_rays; i++)
+        num_hits += terrain->SphereCast(hits[i], origins[i], directions[i], 0.5f, max_t);
+    
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("sphere_cast    rays=%6u  %12.0f rays/s  hits=%u\n", num_rays, num_rays / seconds, num_hits);
+}
+
+//------------------------------------------------------------------
+// Name: bench_precision
+// Desc: Runs the same set of sphere queries through the narrowphase
+//       compiled for one precision policy, storing the mesh relative
+//       to its own centre. Reports queries/s and the contact count,
+//       which should agree closely between policies
+//------------------------------------------------------------------
+template<typename Precision>
+static void bench_precision(const CollisionMesh *terrain) {
+    typedef typename Precision::vector vector;
+    
+    glm::dvec3 origin = (glm::dvec3(terrain->bounds_min) + glm::dvec3(terrain->bounds_max)) * 0.5;
+    PrecisionMesh<Precision> mesh(terrain, origin);
+    
+    const unsigned int num_queries = 20000;
+    std::vector<vector> queries(num_queries);
+    
+    // Small deterministic LCG, so every policy sees the same spheres
+    unsigned int seed = 12345;
+    vec3 extent = terrain->bounds_max - terrain->bounds_min;
+    
+    for(unsigned int i = 0; i < num_queries; i++) {
+        float u[3];
+        
+        for(int k = 0; k < 3; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            u[k] = (seed >> 8) / 16777216.0f;
+        }
+        
+        vec3 pos = terrain->bounds_min + vec3(extent.x * u[0], extent.y * u[1], extent.z * u[2]);
+        queries[i] = mesh.ToLocal(glm::dvec3(pos));
+    }
+    
+    std::vector<BasicCollisionPacket<Precision> > contacts;
+    contacts.reserve(num_queries);
+    
+    typename Precision::scalar r = Precision::ToScalar(1.0);
+    unsigned long long num_contacts = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    for(unsigned int i = 0; i < num_queries; i++) {
+        contacts.clear();
+        num_contacts += mesh.QuerySphere(contacts, queries[i], r);
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    printf("precision_%-6s queries=%5u  %12.0f queries/s  contacts=%llu\n",
+        Precision::Name(), num_queries, num_queries / seconds, num_contacts);
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Benchmark entry point. The terrain is compiled in, so it
+//       runs from any directory without file I/O
+//------------------------------------------------------------------
+int main(int argc, char **argv) {
+    CollisionMesh terrain(playground);
+    
+    printf("terrain: %u triangles\n", terrain.NumTriangles());
+    
+    const unsigned int body_counts[] = { 16, 64, 256, 1024 };
+    
+    for(unsigned int i = 0; i < sizeof(body_counts) / sizeof(body_counts[0]); i++)
+        bench_physics_world(&terrain, body_counts[i]);
+    
+    bench_ray_queries(&terrain);
+    
+    bench_precision<FloatPrecision>(&terrain);
+    bench_precision<DoublePrecision>(&terrain);
+    bench_precision<FixedPrecision>(&terrain);
+    
+    return 0;
+}
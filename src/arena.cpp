@@ -0,0 +1,91 @@
+#include "arena.h"
+
+#include <algorithm>
+
+// Every block is aligned for any scratch type
+#define ARENA_BLOCK_ALIGNMENT 16
+
+//----------------------------------------------------------------
+// Name: FrameArena
+// Desc: Constructor for the FrameArena class
+//----------------------------------------------------------------
+FrameArena::FrameArena(size_t initial_size) {
+    capacity = std::max(initial_size, (size_t)ARENA_BLOCK_ALIGNMENT);
+    block = new unsigned char[capacity];
+    offset = 0;
+    
+    overflow_blocks = nullptr;
+    
+    num_allocations = 0;
+    bytes_used = 0;
+    
+    peak_bytes = 0;
+    num_heap_allocations = 1;
+    num_overflows = 0;
+}
+
+//----------------------------------------------------------------
+// Name: Allocate
+// Desc: Returns uninitialized memory that stays valid until the
+//       next Reset
+//----------------------------------------------------------------
+void *FrameArena::Allocate(size_t size, size_t alignment) {
+    num_allocations++;
+    
+    size_t start = (offset + alignment - 1) & ~(alignment - 1);
+    
+    bytes_used += start - offset + size;
+    peak_bytes = std::max(peak_bytes, bytes_used);
+    
+    if(start + size <= capacity) {
+        offset = start + size;
+        return block + start;
+    }
+    
+    // Out of room: this and the rest of the frame's allocations get their own
+    // heap blocks until the frame ends
+    if(offset <= capacity)
+        num_overflows++;
+    
+    offset = capacity + 1;
+    
+    unsigned char *overflow = new unsigned char[ARENA_BLOCK_ALIGNMENT + size + alignment];
+    num_heap_allocations++;
+    
+    *(unsigned char **)overflow = overflow_blocks;
+    overflow_blocks = overflow;
+    
+    size_t data = ((size_t)overflow + ARENA_BLOCK_ALIGNMENT + alignment - 1) & ~(alignment - 1);
+    return (void *)data;
+}
+
+//----------------------------------------------------------------
+// Name: Reset
+// Desc: Frees everything allocated this frame. If the frame
+//       overflowed, the block grows to fit all of it next time
+//----------------------------------------------------------------
+void FrameArena::Reset() {
+    while(overflow_blocks != nullptr) {
+        unsigned char *next = *(unsigned char **)overflow_blocks;
+        delete[] overflow_blocks;
+        overflow_blocks = next;
+    }
+    
+    if(bytes_used > capacity) {
+        while(capacity < bytes_used)
+            capacity *= 2;
+        
+        delete[] block;
+        block = new unsigned char[capacity];
+        num_heap_allocations++;
+    }
+    
+    offset = 0;
+    num_allocations = 0;
+    bytes_used = 0;
+}
+
+FrameArena::~FrameArena() {
+    Reset();
+    delete[] block;
+}
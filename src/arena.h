@@ -0,0 +1,94 @@
+#pragma once
+
+#include "common.h"
+
+// Starting size of a FrameArena, grown at Reset() if a frame needed more
+#define FRAME_ARENA_DEFAULT_SIZE (64 * 1024)
+
+//------------------------------------------------------------------------
+// Linear allocator for scratch data that only lives for one frame.
+// Allocating bumps an offset into one block and Reset() frees everything
+// at once. A frame that runs out of room takes extra blocks from the heap,
+// and the next Reset() replaces the block with one big enough for that
+// frame, so a steady-state frame never touches the heap
+//------------------------------------------------------------------------
+class FrameArena {
+public:
+    FrameArena(size_t initial_size = FRAME_ARENA_DEFAULT_SIZE);
+    ~FrameArena();
+    
+    void *Allocate(size_t size, size_t alignment);
+    
+    template<typename T>
+    T *Allocate(size_t count) { return (T *)Allocate(count * sizeof(T), alignof(T)); }
+    
+    void Reset();
+    
+    size_t Capacity() const { return capacity; }
+    
+    // Counters for this frame (since the last Reset)
+    unsigned int num_allocations;
+    size_t bytes_used;
+    
+    // Counters over the arena's lifetime
+    size_t peak_bytes;
+    unsigned int num_heap_allocations; // Blocks taken from the heap, including the first
+    unsigned int num_overflows;        // Frames that did not fit the block
+private:
+    // Frame-end cleanup frees these; each starts with a pointer to the next
+    unsigned char *overflow_blocks;
+    
+    unsigned char *block;
+    size_t capacity;
+    size_t offset;
+    
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+};
+
+//------------------------------------------------------------------------
+// Array of plain data in a FrameArena, reserved with a capacity for the
+// frame. Going past the capacity moves the contents to twice the room in
+// the same arena rather than the heap. Only valid until the arena resets
+//------------------------------------------------------------------------
+template<typename T>
+class ArenaArray {
+public:
+    ArenaArray() : arena(nullptr), elements(nullptr), count(0), capacity(0) {}
+    
+    void Reserve(FrameArena *frame_arena, unsigned int initial_capacity) {
+        arena = frame_arena;
+        capacity = initial_capacity > 0 ? initial_capacity : 1;
+        elements = arena->Allocate<T>(capacity);
+        count = 0;
+    }
+    
+    void push_back(const T& value) {
+        if(count == capacity) {
+            T *grown = arena->Allocate<T>(capacity * 2);
+            memcpy(grown, elements, count * sizeof(T));
+            
+            elements = grown;
+            capacity *= 2;
+        }
+        
+        elements[count++] = value;
+    }
+    
+    void clear() { count = 0; }
+    
+    unsigned int size() const { return count; }
+    bool empty() const { return count == 0; }
+    
+    T *data() { return elements; }
+    const T *data() const { return elements; }
+    
+    T& operator[](unsigned int i) { return elements[i]; }
+    const T& operator[](unsigned int i) const { return elements[i]; }
+private:
+    FrameArena *arena;
+    
+    T *elements;
+    unsigned int count;
+    unsigned int capacity;
+};
@@ -0,0 +1,444 @@
+#include "chunkedterrain.h"
+
+#include <algorithm>
+#include <cfloat>
+
+//------------------------------------------------------------------------------------
+// Name: ChunkFilename
+// Desc: Name of one of a chunk's cooked files, as written by tools/chunkcook
+//------------------------------------------------------------------------------------
+static void ChunkFilename(char *filename, size_t size, const terrain_chunk& chunk, const char *extension) {
+    snprintf(filename, size, "chunk_%d_%d.%s", chunk.x, chunk.z, extension);
+}
+
+//------------------------------------------------------------------------------------
+// Name: ChunkedTerrain
+// Desc: Constructor for the ChunkedTerrain class.
+//       Reads the chunk index of a directory cooked by tools/chunkcook and starts
+//       the loading thread. No chunk is loaded until the first Update. The
+//       directory may be given with or without its trailing separator
+//------------------------------------------------------------------------------------
+ChunkedTerrain::ChunkedTerrain(const char *directory, size_t memory_budget, float load_radius) :
+    chunk_size(0.0f), load_radius(load_radius), memory_budget(memory_budget), resident_bytes(0),
+    num_loads(0), num_failed_loads(0), num_evictions(0), render_load(nullptr), render_free(nullptr),
+    render_user(nullptr), next_serial(1), num_in_flight(0), is_stopping(false) {
+    size_t length = strlen(directory);
+    bool has_separator = length > 0 && (directory[length - 1] == '/' || directory[length - 1] == '\\');
+    
+    char index_filepath[320];
+    
+    bool is_too_long =
+        snprintf(this->directory, sizeof(this->directory), "%s%s", directory, has_separator ? "" : "/") >= (int)sizeof(this->directory) ||
+        snprintf(index_filepath, sizeof(index_filepath), "%s%s", this->directory, CHUNK_INDEX_FILENAME) >= (int)sizeof(index_filepath);
+    
+    FILE *index_file = is_too_long ? nullptr : fopen(index_filepath, "r");
+    
+    if(is_too_long) {
+        printf("Chunk directory path is too long:\n%s\n", directory);
+    } else if(!index_file) {
+        printf("Could not open chunk index:\n%s\n", index_filepath);
+    } else {
+        char linebuf[256];
+        
+        while(fgets(linebuf, sizeof(linebuf), index_file) != nullptr) {
+            char prefixbuf[32];
+            
+            if(sscanf(linebuf, "%31s", prefixbuf) != 1)
+                continue;
+            
+            if(!strcmp(prefixbuf, "chunk_size")) {
+                sscanf(linebuf, "%s %f", prefixbuf, &chunk_size);
+            }
+            
+            // chunk <x> <z> <bounds min> <bounds max> <bytes>
+            else if(!strcmp(prefixbuf, "chunk")) {
+                terrain_chunk chunk;
+                
+                int fields = sscanf(linebuf, "%s %d %d %f %f %f %f %f %f %u", prefixbuf,
+                    &chunk.x, &chunk.z,
+                    &chunk.bounds_min.x, &chunk.bounds_min.y, &chunk.bounds_min.z,
+                    &chunk.bounds_max.x, &chunk.bounds_max.y, &chunk.bounds_max.z,
+                    &chunk.num_bytes
+                    );
+                
+                if(fields != 10)
+                    continue;
+                
+                chunk.state = CHUNK_UNLOADED;
+                chunk.is_wanted = false;
+                chunk.mesh = nullptr;
+                chunk.render_data = nullptr;
+                chunk.serial = 0;
+                
+                chunks.push_back(chunk);
+            }
+        }
+        
+        fclose(index_file);
+    }
+    
+    distances.resize(chunks.size(), FLT_MAX);
+    
+    worker = std::thread(&ChunkedTerrain::WorkerLoop, this);
+}
+
+//------------------------------------------------------------------------------------
+// Name: SetRenderLoader
+// Desc: Sets the functions that load and free each chunk's render data alongside
+//       its collision mesh. Call before the first Update
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::SetRenderLoader(chunk_render_load_func load, chunk_render_free_func free, void *user) {
+    render_load = load;
+    render_free = free;
+    render_user = user;
+}
+
+//------------------------------------------------------------------------------------
+// Name: WorkerLoop
+// Desc: Loading thread. Takes the nearest queued chunk, reads its cooked files
+//       without holding the lock, and hands the result back to AdoptLoads
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    while(true) {
+        work_ready.wait(lock, [this] { return is_stopping || !load_queue.empty(); });
+        
+        if(is_stopping)
+            return;
+        
+        chunk_load_result load;
+        load.chunk = load_queue.front();
+        load_queue.erase(load_queue.begin());
+        
+        num_in_flight++;
+        lock.unlock();
+        
+        // The index never changes after construction, so it is safe to read here
+        const terrain_chunk &chunk = chunks[load.chunk];
+        
+        char filename[64];
+        char filepath[320];
+        
+        ChunkFilename(filename, sizeof(filename), chunk, "col");
+        snprintf(filepath, sizeof(filepath), "%s%s", directory, filename);
+        
+        load.mesh = new CollisionMesh();
+        load.is_loaded = load.mesh->LoadCooked(filepath);
+        
+        load.render_data = nullptr;
+        
+        if(render_load != nullptr) {
+            ChunkFilename(filename, sizeof(filename), chunk, "obj");
+            load.render_data = render_load(directory, filename, render_user);
+        }
+        
+        lock.lock();
+        
+        finished.push_back(load);
+        num_in_flight--;
+        
+        work_done.notify_all();
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Name: FreeLoad
+// Desc: Frees the collision and render data of a loaded chunk
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::FreeLoad(const chunk_load_result& load) {
+    if(load.render_data != nullptr && render_free != nullptr)
+        render_free(load.render_data, render_user);
+    
+    delete load.mesh;
+}
+
+//------------------------------------------------------------------------------------
+// Name: AdoptLoads
+// Desc: Makes the chunks the worker has finished loading resident, or frees them
+//       straight away if they stopped being wanted while they loaded. A chunk that
+//       failed to load gives back its share of the budget and is marked failed
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::AdoptLoads() {
+    std::vector<chunk_load_result> loads;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loads.swap(finished);
+    }
+    
+    for(unsigned int i = 0; i < loads.size(); i++) {
+        terrain_chunk &chunk = chunks[loads[i].chunk];
+        
+        if(!loads[i].is_loaded) {
+            FreeLoad(loads[i]);
+            
+            chunk.state = CHUNK_FAILED;
+            chunk.is_wanted = false;
+            resident_bytes -= chunk.num_bytes;
+            
+            num_failed_loads++;
+            continue;
+        }
+        
+        if(!chunk.is_wanted) {
+            FreeLoad(loads[i]);
+            
+            chunk.state = CHUNK_UNLOADED;
+            resident_bytes -= chunk.num_bytes;
+            continue;
+        }
+        
+        chunk.state = CHUNK_RESIDENT;
+        chunk.mesh = loads[i].mesh;
+        chunk.render_data = loads[i].render_data;
+        chunk.serial = next_serial++;
+        
+        resident.insert(std::lower_bound(resident.begin(), resident.end(), loads[i].chunk), loads[i].chunk);
+        
+        num_loads++;
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Name: Evict
+// Desc: Frees a resident chunk
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::Evict(unsigned int index) {
+    terrain_chunk &chunk = chunks[index];
+    
+    chunk_load_result load = { index, chunk.mesh, chunk.render_data, true };
+    FreeLoad(load);
+    
+    chunk.state = CHUNK_UNLOADED;
+    chunk.is_wanted = false;
+    chunk.mesh = nullptr;
+    chunk.render_data = nullptr;
+    
+    resident.erase(std::lower_bound(resident.begin(), resident.end(), index));
+    resident_bytes -= chunk.num_bytes;
+    
+    num_evictions++;
+}
+
+//------------------------------------------------------------------------------------
+// Name: Update
+// Desc: Streams the terrain around the focus points: adopts finished loads,
+//       evicts chunks beyond the load radius (plus CHUNK_EVICT_MARGIN), and queues
+//       the chunks within it, nearest first, as far as the memory budget allows.
+//       A chunk that doesn't fit may push out a resident one farther away.
+//       Call once per frame, between simulation steps
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::Update(const vec3 *focus, unsigned int num_focus) {
+    AdoptLoads();
+    
+    // Distance on the XZ plane from each chunk's bounds to the nearest focus point
+    for(unsigned int i = 0; i < chunks.size(); i++) {
+        const terrain_chunk &chunk = chunks[i];
+        float nearest = FLT_MAX;
+        
+        for(unsigned int f = 0; f < num_focus; f++) {
+            float dx = fmaxf(fmaxf(chunk.bounds_min.x - focus[f].x, focus[f].x - chunk.bounds_max.x), 0.0f);
+            float dz = fmaxf(fmaxf(chunk.bounds_min.z - focus[f].z, focus[f].z - chunk.bounds_max.z), 0.0f);
+            
+            nearest = fminf(nearest, sqrtf(dx * dx + dz * dz));
+        }
+        
+        distances[i] = nearest;
+    }
+    
+    // Drop what has moved out of range. A chunk the worker has already started
+    // on is freed when it arrives
+    float evict_radius = load_radius + CHUNK_EVICT_MARGIN;
+    
+    for(unsigned int i = 0; i < chunks.size(); i++) {
+        terrain_chunk &chunk = chunks[i];
+        
+        if(distances[i] <= evict_radius)
+            continue;
+        
+        if(chunk.state == CHUNK_RESIDENT) {
+            Evict(i);
+        } else if(chunk.state == CHUNK_LOADING && chunk.is_wanted) {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<unsigned int>::iterator queued = std::find(load_queue.begin(), load_queue.end(), i);
+            
+            if(queued != load_queue.end()) {
+                load_queue.erase(queued);
+                
+                chunk.state = CHUNK_UNLOADED;
+                resident_bytes -= chunk.num_bytes;
+            }
+            
+            chunk.is_wanted = false;
+        }
+    }
+    
+    // Request what is in range, nearest first
+    requests.clear();
+    
+    for(unsigned int i = 0; i < chunks.size(); i++) {
+        if(distances[i] > load_radius)
+            continue;
+        
+        // Still on its way, so just keep it
+        if(chunks[i].state == CHUNK_LOADING)
+            chunks[i].is_wanted = true;
+        else if(chunks[i].state == CHUNK_UNLOADED)
+            requests.push_back(i);
+    }
+    
+    std::sort(requests.begin(), requests.end(), [this](unsigned int a, unsigned int b) {
+        return distances[a] < distances[b];
+    });
+    
+    unsigned int num_accepted = 0;
+    
+    for(unsigned int r = 0; r < requests.size(); r++) {
+        terrain_chunk &chunk = chunks[requests[r]];
+        
+        // Make room by evicting resident chunks farther away than this one
+        while(resident_bytes + chunk.num_bytes > memory_budget) {
+            unsigned int farthest = 0;
+            float farthest_distance = distances[requests[r]];
+            bool is_found = false;
+            
+            for(unsigned int i = 0; i < resident.size(); i++) {
+                if(distances[resident[i]] > farthest_distance) {
+                    farthest = resident[i];
+                    farthest_distance = distances[resident[i]];
+                    is_found = true;
+                }
+            }
+            
+            if(!is_found)
+                break;
+            
+            Evict(farthest);
+        }
+        
+        // Nearer chunks already fill the budget
+        if(resident_bytes + chunk.num_bytes > memory_budget)
+            break;
+        
+        chunk.state = CHUNK_LOADING;
+        chunk.is_wanted = true;
+        resident_bytes += chunk.num_bytes;
+        
+        requests[num_accepted++] = requests[r];
+    }
+    
+    if(num_accepted == 0)
+        return;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    load_queue.insert(load_queue.end(), requests.begin(), requests.begin() + num_accepted);
+    
+    // Earlier requests may no longer be the nearest
+    std::stable_sort(load_queue.begin(), load_queue.end(), [this](unsigned int a, unsigned int b) {
+        return distances[a] < distances[b];
+    });
+    
+    work_ready.notify_one();
+}
+
+//------------------------------------------------------------------------------------
+// Name: WaitForLoads
+// Desc: Blocks until every queued chunk has loaded, then adopts them. Used at
+//       startup so the terrain under the player is there for the first step
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::WaitForLoads() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        work_done.wait(lock, [this] { return load_queue.empty() && num_in_flight == 0; });
+    }
+    
+    AdoptLoads();
+}
+
+//------------------------------------------------------------------------------------
+// Name: QueryChunks
+// Desc: Appends every resident chunk whose triangles' bounds overlap the box
+//------------------------------------------------------------------------------------
+void ChunkedTerrain::QueryChunks(vec3 box_min, vec3 box_max, ArenaArray<const terrain_chunk *>& found) const {
+    for(unsigned int i = 0; i < resident.size(); i++) {
+        const terrain_chunk &chunk = chunks[resident[i]];
+        
+        if(box_max.x < chunk.bounds_min.x || box_min.x > chunk.bounds_max.x ||
+           box_max.y < chunk.bounds_min.y || box_min.y > chunk.bounds_max.y ||
+           box_max.z < chunk.bounds_min.z || box_min.z > chunk.bounds_max.z)
+            continue;
+        
+        found.push_back(&chunk);
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Name: RayCast
+// Desc: Finds the closest triangle hit by the ray in any resident chunk
+//------------------------------------------------------------------------------------
+bool ChunkedTerrain::RayCast(RayHit& hit, vec3 O, vec3 D, float max_t) const {
+    bool is_hit = false;
+    
+    hit.t = max_t;
+    hit.triangle = COLLISION_NO_TRIANGLE;
+    
+    for(unsigned int i = 0; i < resident.size(); i++) {
+        RayHit chunk_hit;
+        
+        if(chunks[resident[i]].mesh->RayCast(chunk_hit, O, D, hit.t)) {
+            hit = chunk_hit;
+            is_hit = true;
+        }
+    }
+    
+    return is_hit;
+}
+
+//------------------------------------------------------------------------------------
+// Name: SphereCast
+// Desc: Finds the first triangle the swept sphere touches in any resident chunk
+//------------------------------------------------------------------------------------
+bool ChunkedTerrain::SphereCast(RayHit& hit, vec3 O, vec3 D, float r, float max_t) const {
+    bool is_hit = false;
+    
+    hit.t = max_t;
+    hit.triangle = COLLISION_NO_TRIANGLE;
+    
+    for(unsigned int i = 0; i < resident.size(); i++) {
+        RayHit chunk_hit;
+        
+        if(chunks[resident[i]].mesh->SphereCast(chunk_hit, O, D, r, hit.t)) {
+            hit = chunk_hit;
+            is_hit = true;
+        }
+    }
+    
+    return is_hit;
+}
+
+//------------------------------------------------------------------------------------
+// Name: ~ChunkedTerrain
+// Desc: Stops the loading thread and frees every chunk. With a render loader set,
+//       call it while the render data can still be freed (e.g. the GL context)
+//------------------------------------------------------------------------------------
+ChunkedTerrain::~ChunkedTerrain() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        is_stopping = true;
+        load_queue.clear();
+    }
+    
+    work_ready.notify_all();
+    worker.join();
+    
+    for(unsigned int i = 0; i < chunks.size(); i++)
+        chunks[i].is_wanted = false;
+    
+    AdoptLoads();
+    
+    while(!resident.empty())
+        Evict(resident.back());
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "common.h"
+#include "arena.h"
+#include "collisionmesh.h"
+
+// Written by tools/chunkcook next to the cooked chunks
+#define CHUNK_INDEX_FILENAME "chunks.txt"
+
+// Chunk states
+#define CHUNK_UNLOADED 0
+#define CHUNK_LOADING  1 // Queued for, or being loaded by, the worker thread
+#define CHUNK_RESIDENT 2
+#define CHUNK_FAILED   3 // Its cooked files could not be read, so it is never requested again
+
+// How much further than the load radius a chunk may get before it is evicted,
+// so a body moving back and forth over the edge doesn't reload it every frame
+#define CHUNK_EVICT_MARGIN 4.0f
+
+// Optional render data for each chunk. load is called on the worker thread,
+// free on the thread calling Update (or the destructor)
+typedef void *(*chunk_render_load_func)(const char *directory, const char *filename, void *user);
+typedef void (*chunk_render_free_func)(void *render_data, void *user);
+
+typedef struct {
+    // Grid cell, chunk_size wide on X and Z
+    int x;
+    int z;
+    
+    // Bounds of the chunk's triangles, which can overhang its cell
+    vec3 bounds_min;
+    vec3 bounds_max;
+    
+    unsigned int num_bytes; // Size of the cooked files, counted against the memory budget
+    
+    int state;
+    bool is_wanted; // Cleared for a chunk that is no longer needed before its load finishes
+    
+    // Only valid while resident
+    CollisionMesh *mesh;
+    void *render_data;
+    unsigned int serial; // Different every time the chunk is loaded
+} terrain_chunk;
+
+typedef struct {
+    unsigned int chunk;
+    
+    CollisionMesh *mesh;
+    void *render_data;
+    
+    bool is_loaded; // False if the cooked collision mesh was missing or invalid
+} chunk_load_result;
+
+//------------------------------------------------------------------------
+// Terrain split into a grid of chunks by tools/chunkcook, each with its
+// own cooked collision mesh (and render mesh). Update streams in the
+// chunks within load_radius of a set of focus points (the player, or
+// every body) on a worker thread, nearest first, and evicts chunks that
+// are no longer needed, farthest first when the memory budget is full.
+// Queries see the resident chunks as one terrain: a sphere straddling a
+// border is tested against every chunk it overlaps
+//------------------------------------------------------------------------
+class ChunkedTerrain {
+public:
+    ChunkedTerrain(const char *directory, size_t memory_budget, float load_radius);
+    ~ChunkedTerrain();
+    
+    void SetRenderLoader(chunk_render_load_func load, chunk_render_free_func free, void *user);
+    
+    void Update(const vec3 *focus, unsigned int num_focus);
+    void WaitForLoads();
+    
+    unsigned int NumChunks() const { return (unsigned int)chunks.size(); }
+    
+    // Queries over the resident chunks. Triangle indices in hits refer to the mesh of the chunk hit
+    void QueryChunks(vec3 box_min, vec3 box_max, ArenaArray<const terrain_chunk *>& found) const;
+    bool RayCast(RayHit& hit, vec3 O, vec3 D, float max_t) const;
+    bool SphereCast(RayHit& hit, vec3 O, vec3 D, float r, float max_t) const;
+    
+    char directory[256]; // Always ends in a separator
+    
+    float chunk_size;
+    float load_radius;
+    
+    size_t memory_budget;
+    size_t resident_bytes; // Resident chunks and those being loaded
+    
+    std::vector<terrain_chunk> chunks;
+    
+    // Indices of the resident chunks, in ascending order
+    std::vector<unsigned int> resident;
+    
+    // Totals since construction
+    unsigned int num_loads;
+    unsigned int num_failed_loads;
+    unsigned int num_evictions;
+private:
+    void WorkerLoop();
+    void AdoptLoads();
+    void Evict(unsigned int chunk);
+    void FreeLoad(const chunk_load_result& load);
+    
+    chunk_render_load_func render_load;
+    chunk_render_free_func render_free;
+    void *render_user;
+    
+    unsigned int next_serial;
+    
+    // Distance of each chunk from the nearest focus point, from the last Update
+    std::vector<float> distances;
+    std::vector<unsigned int> requests;
+    
+    // Shared with the worker thread, guarded by the mutex
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    
+    std::vector<unsigned int> load_queue; // Nearest chunk first
+    std::vector<chunk_load_result> finished;
+    unsigned int num_in_flight;
+    bool is_stopping;
+};
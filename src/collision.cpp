@@ -1,98 +1,266 @@
 #include "collision.h"
+#include "collisionkernel.h"
 
 //--------------------------------------------------------------------------------
 // Name: IsIntersectingSphereTriangle
-// Desc: Performs a test to check if a given sphere intersects with a triangle
-//       
-//       Adapted from:
-//       http://realtimecollisiondetection.net/blog/?p=103
+// Desc: Performs a test to check if a given sphere intersects with a triangle.
+//       See IsIntersectingSphereTriangleT for the kernel itself
 //--------------------------------------------------------------------------------
 bool IsIntersectingSphereTriangle(CollisionPacket& collisionPacket, vec3 A, vec3 B, vec3 C, vec3 P, float r) {
-    // Transform the triangle vertices to sphere-space
-    A = A - P;
-    B = B - P;
-    C = C - P;
-    
-    // Is sphere intersecting triangle plane?
-    float rr = r * r;
-    vec3 V = normalize(cross(B - A, C - A));
-    float d = dot(A, V);
-    
-    // Extra optimization to ignore collision from behind the triangle
-    if(d > 0.25f)
+    BasicCollisionPacket<FloatPrecision> packet;
+    
+    if(!IsIntersectingSphereTriangleT<FloatPrecision>(packet, A, B, C, P, r))
         return false;
     
-    float e = dot(V, V);
-    int sep1 = d * d > rr * e;
+    collisionPacket.normal = packet.normal;
+    collisionPacket.distance = packet.distance;
     
-    if (sep1)
+    return true;
+}
+
+//--------------------------------------------------------------------------------
+// Name: IsIntersectingSphereSphere
+// Desc: Performs a test to check if two given spheres intersect each other.
+//       On a hit, the packet normal points from the second sphere towards the
+//       first, and the distance is the (positive) penetration depth
+//--------------------------------------------------------------------------------
+bool IsIntersectingSphereSphere(CollisionPacket& collisionPacket, vec3 P1, float r1, vec3 P2, float r2) {
+    BasicCollisionPacket<FloatPrecision> packet;
+    
+    if(!IsIntersectingSphereSphereT<FloatPrecision>(packet, P1, r1, P2, r2))
         return false;
     
-    // Is sphere intersecting point A?
-    float aa = dot(A, A);
-    float ab = dot(A, B);
-    float ac = dot(A, C);
-    int sep2 = (aa > rr) & (ab > aa) & (ac > aa);
+    collisionPacket.normal = packet.normal;
+    collisionPacket.distance = packet.distance;
+    
+    return true;
+}
+
+//--------------------------------------------------------------------------------
+// Name: ClosestPointOnTriangle
+// Desc: Returns the point on triangle ABC closest to point P
+//
+//       Adapted from:
+//       Real-Time Collision Detection (Ericson), section 5.1.5
+//--------------------------------------------------------------------------------
+vec3 ClosestPointOnTriangle(vec3 P, vec3 A, vec3 B, vec3 C) {
+    vec3 AB = B - A;
+    vec3 AC = C - A;
+    
+    // Is P in vertex region outside A?
+    vec3 AP = P - A;
+    float d1 = dot(AB, AP);
+    float d2 = dot(AC, AP);
+    
+    if(d1 <= 0.0f && d2 <= 0.0f)
+        return A;
+    
+    // Is P in vertex region outside B?
+    vec3 BP = P - B;
+    float d3 = dot(AB, BP);
+    float d4 = dot(AC, BP);
+    
+    if(d3 >= 0.0f && d4 <= d3)
+        return B;
+    
+    // Is P in edge region of AB?
+    float vc = d1 * d4 - d3 * d2;
+    
+    if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return A + AB * (d1 / (d1 - d3));
+    
+    // Is P in vertex region outside C?
+    vec3 CP = P - C;
+    float d5 = dot(AB, CP);
+    float d6 = dot(AC, CP);
+    
+    if(d6 >= 0.0f && d5 <= d6)
+        return C;
+    
+    // Is P in edge region of AC?
+    float vb = d5 * d2 - d1 * d6;
+    
+    if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return A + AC * (d2 / (d2 - d6));
+    
+    // Is P in edge region of BC?
+    float va = d3 * d6 - d5 * d4;
+    
+    if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return B + (C - B) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    
+    // P is inside the face region
+    float denom = 1.0f / (va + vb + vc);
+    
+    return A + AB * (vb * denom) + AC * (vc * denom);
+}
+
+//--------------------------------------------------------------------------------
+// Name: IsIntersectingRayTriangle
+// Desc: Moeller-Trumbore ray-triangle test. Both sides of the triangle are hit.
+//       D does not need to be normalized; t is returned in units of D
+//--------------------------------------------------------------------------------
+bool IsIntersectingRayTriangle(float& t, vec3 O, vec3 D, vec3 A, vec3 B, vec3 C) {
+    vec3 E1 = B - A;
+    vec3 E2 = C - A;
+    
+    vec3 P = cross(D, E2);
+    float det = dot(E1, P);
     
-    if (sep2)
+    // Ray is parallel to the triangle plane
+    if(fabsf(det) < 1e-8f)
         return false;
     
-    // Is sphere intersecting point B?
-    float bb = dot(B, B);
-    float bc = dot(B, C);
-    int sep3 = (bb > rr) & (ab > bb) & (bc > bb);
+    float inv_det = 1.0f / det;
     
-    if (sep3)
+    vec3 T = O - A;
+    float u = dot(T, P) * inv_det;
+    
+    if(u < 0.0f || u > 1.0f)
         return false;
     
-    // Is sphere intersecting point C?
-    float cc = dot(C, C);
-    int sep4 = (cc > rr) & (ac > cc) & (bc > cc);
+    vec3 Q = cross(T, E1);
+    float v = dot(D, Q) * inv_det;
     
-    if (sep4)
+    if(v < 0.0f || u + v > 1.0f)
         return false;
     
-    // Calculate triangle edge deltas
-    vec3 AB = B - A;
-    vec3 BC = C - B;
-    vec3 CA = A - C;
+    t = dot(E2, Q) * inv_det;
+    
+    return t >= 0.0f;
+}
+
+//--------------------------------------------------------------------------------
+// Name: IsIntersectingRaySphere
+// Desc: Ray-sphere test for a normalized direction D. Fails if the ray starts
+//       inside the sphere
+//--------------------------------------------------------------------------------
+static bool IsIntersectingRaySphere(float& t, vec3 O, vec3 D, vec3 S, float r) {
+    vec3 M = O - S;
+    float b = dot(M, D);
+    float c = dot(M, M) - r * r;
+    
+    if(c < 0.0f || b > 0.0f)
+        return false;
+    
+    float disc = b * b - c;
+    
+    if(disc < 0.0f)
+        return false;
+    
+    t = -b - sqrtf(disc);
+    
+    return t >= 0.0f;
+}
+
+//--------------------------------------------------------------------------------
+// Name: IsIntersectingRayCylinder
+// Desc: Ray test against the side of a capped-off cylinder of radius r around
+//       segment PQ, for a normalized direction D
+//
+//       Adapted from:
+//       Real-Time Collision Detection (Ericson), section 5.3.7
+//--------------------------------------------------------------------------------
+static bool IsIntersectingRayCylinder(float& t, vec3 O, vec3 D, vec3 P, vec3 Q, float r) {
+    vec3 d = Q - P;
+    vec3 m = O - P;
     
-    // Is sphere intersecting edge A to B?
-    float d1 = ab - aa;
-    float e1 = dot(AB, AB);
+    float dd = dot(d, d);
+    float md = dot(m, d);
+    float nd = dot(D, d);
+    float mn = dot(m, D);
     
-    vec3 Q1 = A * e1 - AB * d1;
-    vec3 QC = C * e1 - Q1;
-    int sep5 = (dot(Q1, Q1) > rr * e1 * e1) & (dot(Q1, QC) > 0);
+    float a = dd - nd * nd;
     
-    if (sep5)
+    // Ray runs parallel to the axis; the end spheres catch this case
+    if(fabsf(a) < 1e-8f)
         return false;
     
-    // Is sphere intersecting edge B to C?
-    float d2 = bc - bb;
-    float e2 = dot(BC, BC);
+    float k = dot(m, m) - r * r;
+    float b = dd * mn - nd * md;
+    float c = dd * k - md * md;
+    
+    float disc = b * b - a * c;
+    
+    if(disc < 0.0f)
+        return false;
     
-    vec3 Q2 = B * e2 - BC * d2;
-    vec3 QA = A * e2 - Q2;
-    int sep6 = (dot(Q2, Q2) > rr * e2 * e2) & (dot(Q2, QA) > 0);
+    t = (-b - sqrtf(disc)) / a;
     
-    if (sep6)
+    if(t < 0.0f)
         return false;
     
-    // Is sphere intersecting edge C to A?
-    float d3 = ac - cc;
-    float e3 = dot(CA, CA);
+    // Hit must lie between the two end caps
+    float s = md + t * nd;
     
-    vec3 Q3 = C * e3 - CA * d3;
-    vec3 QB = B * e3 - Q3;
-    int sep7 = (dot(Q3, Q3) > rr * e3 * e3) & (dot(Q3, QB) > 0);
+    return s >= 0.0f && s <= dd;
+}
+
+//--------------------------------------------------------------------------------
+// Name: IsIntersectingSphereCastTriangle
+// Desc: Sweeps a sphere of radius r from O along the normalized direction D and
+//       finds the first contact with triangle ABC within max_t. This is a ray
+//       cast against the triangle grown by r: its offset face, the capsules
+//       around its edges, and the spheres at its corners
+//--------------------------------------------------------------------------------
+bool IsIntersectingSphereCastTriangle(RayHit& hit, vec3 O, vec3 D, float r, float max_t, vec3 A, vec3 B, vec3 C) {
+    // Already touching at the start of the sweep?
+    vec3 Q = ClosestPointOnTriangle(O, A, B, C);
+    vec3 OQ = O - Q;
     
-    if (sep7)
+    if(dot(OQ, OQ) <= r * r) {
+        vec3 N = cross(B - A, C - A);
+        
+        hit.t = 0.0f;
+        hit.normal = dot(OQ, OQ) > 1e-12f ? normalize(OQ) : normalize(dot(OQ, N) < 0.0f ? -N : N);
+        
+        return true;
+    }
+    
+    // Face: a hit here always comes before any edge or corner hit
+    vec3 N = normalize(cross(B - A, C - A));
+    
+    if(dot(O - A, N) < 0.0f)
+        N = -N;
+    
+    vec3 offset = N * r;
+    float t;
+    
+    if(dot(D, N) < 0.0f && IsIntersectingRayTriangle(t, O, D, A + offset, B + offset, C + offset)) {
+        if(t > max_t)
+            return false;
+        
+        hit.t = t;
+        hit.normal = N;
+        
+        return true;
+    }
+    
+    // Edges and corners
+    const vec3 corners[3] = { A, B, C };
+    float best_t = max_t;
+    bool found = false;
+    
+    for(int i = 0; i < 3; i++) {
+        if(IsIntersectingRayCylinder(t, O, D, corners[i], corners[(i + 1) % 3], r) && t <= best_t) {
+            best_t = t;
+            found = true;
+        }
+        
+        if(IsIntersectingRaySphere(t, O, D, corners[i], r) && t <= best_t) {
+            best_t = t;
+            found = true;
+        }
+    }
+    
+    if(!found)
         return false;
     
-    // Sphere intersects triangle; calculate amount to push sphere back
-    collisionPacket.normal = V;
-    collisionPacket.distance = d;
+    // The contact normal points from the touched feature to the sphere centre
+    vec3 P = O + D * best_t;
+    
+    hit.t = best_t;
+    hit.normal = normalize(P - ClosestPointOnTriangle(P, A, B, C));
     
     return true;
 }
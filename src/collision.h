@@ -1,10 +1,24 @@
 #pragma once
 
-#include "main.h"
+#include "common.h"
 
 typedef struct {
     vec3 normal;
     float distance;
 } CollisionPacket;
 
+#define COLLISION_NO_TRIANGLE 0xFFFFFFFFu
+
+typedef struct {
+    float t;
+    vec3 normal;
+    unsigned int triangle;
+} RayHit;
+
 bool IsIntersectingSphereTriangle(CollisionPacket& collisionPacket, vec3 A, vec3 B, vec3 C, vec3 P, float r);
+bool IsIntersectingSphereSphere(CollisionPacket& collisionPacket, vec3 P1, float r1, vec3 P2, float r2);
+
+vec3 ClosestPointOnTriangle(vec3 P, vec3 A, vec3 B, vec3 C);
+
+bool IsIntersectingRayTriangle(float& t, vec3 O, vec3 D, vec3 A, vec3 B, vec3 C);
+bool IsIntersectingSphereCastTriangle(RayHit& hit, vec3 O, vec3 D, float r, float max_t, vec3 A, vec3 B, vec3 C);
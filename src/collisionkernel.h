@@ -0,0 +1,155 @@
+#pragma once
+
+#include "precision.h"
+
+// Result of a templated narrowphase test, in the policy's own types
+template<typename Precision>
+struct BasicCollisionPacket {
+    typename Precision::vector normal;
+    typename Precision::scalar distance;
+};
+
+//--------------------------------------------------------------------------------
+// Name: IsIntersectingSphereTriangleT
+// Desc: The sphere-triangle test, written once over a precision policy.
+//       IsIntersectingSphereTriangle is this kernel with FloatPrecision
+//
+//       Adapted from:
+//       http://realtimecollisiondetection.net/blog/?p=103
+//--------------------------------------------------------------------------------
+template<typename Precision>
+inline bool IsIntersectingSphereTriangleT(BasicCollisionPacket<Precision>& collisionPacket,
+    typename Precision::vector A, typename Precision::vector B, typename Precision::vector C,
+    typename Precision::vector P, typename Precision::scalar r) {
+    typedef typename Precision::scalar scalar;
+    typedef typename Precision::vector vector;
+    
+    // Transform the triangle vertices to sphere-space
+    A = A - P;
+    B = B - P;
+    C = C - P;
+    
+    // A degenerate triangle (or one too small for the precision) has no
+    // plane, so no contact; normalizing its normal would divide by zero
+    vector N = cross(B - A, C - A);
+    
+    if(!(dot(N, N) > scalar(0)))
+        return false;
+    
+    // Is sphere intersecting triangle plane?
+    scalar rr = r * r;
+    vector V = normalize(N);
+    scalar d = dot(A, V);
+    
+    // Extra optimization to ignore collision from behind the triangle
+    if(d > scalar(0.25f))
+        return false;
+    
+    scalar e = dot(V, V);
+    int sep1 = d * d > rr * e;
+    
+    if (sep1)
+        return false;
+    
+    // Is sphere intersecting point A?
+    scalar aa = dot(A, A);
+    scalar ab = dot(A, B);
+    scalar ac = dot(A, C);
+    int sep2 = (aa > rr) & (ab > aa) & (ac > aa);
+    
+    if (sep2)
+        return false;
+    
+    // Is sphere intersecting point B?
+    scalar bb = dot(B, B);
+    scalar bc = dot(B, C);
+    int sep3 = (bb > rr) & (ab > bb) & (bc > bb);
+    
+    if (sep3)
+        return false;
+    
+    // Is sphere intersecting point C?
+    scalar cc = dot(C, C);
+    int sep4 = (cc > rr) & (ac > cc) & (bc > cc);
+    
+    if (sep4)
+        return false;
+    
+    // Calculate triangle edge deltas
+    vector AB = B - A;
+    vector BC = C - B;
+    vector CA = A - C;
+    
+    // Is sphere intersecting edge A to B?
+    scalar d1 = ab - aa;
+    scalar e1 = dot(AB, AB);
+    
+    vector Q1 = A * e1 - AB * d1;
+    vector QC = C * e1 - Q1;
+    int sep5 = (dot(Q1, Q1) > rr * e1 * e1) & (dot(Q1, QC) > scalar(0));
+    
+    if (sep5)
+        return false;
+    
+    // Is sphere intersecting edge B to C?
+    scalar d2 = bc - bb;
+    scalar e2 = dot(BC, BC);
+    
+    vector Q2 = B * e2 - BC * d2;
+    vector QA = A * e2 - Q2;
+    int sep6 = (dot(Q2, Q2) > rr * e2 * e2) & (dot(Q2, QA) > scalar(0));
+    
+    if (sep6)
+        return false;
+    
+    // Is sphere intersecting edge C to A?
+    scalar d3 = ac - cc;
+    scalar e3 = dot(CA, CA);
+    
+    vector Q3 = C * e3 - CA * d3;
+    vector QB = B * e3 - Q3;
+    int sep7 = (dot(Q3, Q3) > rr * e3 * e3) & (dot(Q3, QB) > scalar(0));
+    
+    if (sep7)
+        return false;
+    
+    // Sphere intersects triangle; calculate amount to push sphere back
+    collisionPacket.normal = V;
+    collisionPacket.distance = d;
+    
+    return true;
+}
+
+//--------------------------------------------------------------------------------
+// Name: IsIntersectingSphereSphereT
+// Desc: The sphere-sphere test over a precision policy. The normal points from
+//       the second sphere towards the first; distance is the penetration depth
+//--------------------------------------------------------------------------------
+template<typename Precision>
+inline bool IsIntersectingSphereSphereT(BasicCollisionPacket<Precision>& collisionPacket,
+    typename Precision::vector P1, typename Precision::scalar r1,
+    typename Precision::vector P2, typename Precision::scalar r2) {
+    typedef typename Precision::scalar scalar;
+    typedef typename Precision::vector vector;
+    
+    vector D = P1 - P2;
+    scalar rr = r1 + r2;
+    scalar dd = dot(D, D);
+    
+    if(dd >= rr * rr)
+        return false;
+    
+    // Coincident centres have no meaningful direction, so just push upwards
+    if(dd > scalar(0)) {
+        using std::sqrt;
+        scalar dist = sqrt(dd);
+        collisionPacket.normal = D / dist;
+        collisionPacket.distance = rr - dist;
+    }
+    else {
+        collisionPacket.normal = vector(scalar(0), scalar(1), scalar(0));
+        collisionPacket.distance = rr;
+    }
+    
+    return true;
+}
@@ -0,0 +1,721 @@
+#include "collisionmesh.h"
+#include "debugdraw.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <stdint.h>
+
+// Deepest BVH traversal supported; the median split keeps real trees far shallower
+#define BVH_STACK_SIZE 64
+
+// Cooked mesh files: a header, then the triangles and BVH nodes as stored in memory
+#define COLLISION_COOKED_MAGIC   "STCC"
+#define COLLISION_COOKED_VERSION 1
+
+static_assert(sizeof(vec3) == 3 * sizeof(float), "cooked triangles are read straight into vec3s");
+static_assert(sizeof(collision_bvh_node) == sizeof(embedded_bvh_node), "cooked nodes are read straight into the BVH");
+
+//------------------------------------------------------------------------------------
+// Name: CollisionMesh
+// Desc: Constructor for an empty CollisionMesh, to be filled with AddTriangle
+//------------------------------------------------------------------------------------
+CollisionMesh::CollisionMesh() {
+    bounds_min = vec3(FLT_MAX);
+    bounds_max = vec3(-FLT_MAX);
+}
+
+//------------------------------------------------------------------------------------
+// Name: CollisionMesh
+// Desc: Constructor for the CollisionMesh class.
+//       Reads only the vertex positions and faces of an OBJ model file, so
+//       collision geometry can be loaded without a GL context
+//------------------------------------------------------------------------------------
+CollisionMesh::CollisionMesh(const char *directory, const char *filename) : CollisionMesh() {
+    char obj_filepath[256];
+    strcpy(obj_filepath, directory);
+    strcat(obj_filepath, filename);
+    
+    FILE *obj_file = fopen(obj_filepath, "r");
+    
+    if(!obj_file) {
+        printf("Could not open OBJ file:\n%s\n", obj_filepath);
+        return;
+    }
+    
+    char linebuf[128];
+    std::vector<vec3> vertices;
+    
+    while(fgets(linebuf, sizeof(linebuf), obj_file) != nullptr) {
+        char prefixbuf[32];
+        
+        if(sscanf(linebuf, "%31s", prefixbuf) != 1)
+            continue;
+        
+        // Parse vertices
+        if(!strcmp(prefixbuf, "v")) {
+            vec3 vertex;
+            sscanf(linebuf, "%s %f %f %f", prefixbuf, &vertex.x, &vertex.y, &vertex.z);
+            vertices.push_back(vertex);
+        }
+        
+        // Parse faces (only the position index of each corner is needed)
+        else if(!strcmp(prefixbuf, "f")) {
+            char corner[3][64];
+            
+            if(sscanf(linebuf, "%s %63s %63s %63s", prefixbuf, corner[0], corner[1], corner[2]) != 4)
+                continue;
+            
+            // Face indices start at 1, so we adjust accordingly
+            unsigned int a = atoi(corner[0]) - 1;
+            unsigned int b = atoi(corner[1]) - 1;
+            unsigned int c = atoi(corner[2]) - 1;
+            
+            if(a >= vertices.size() || b >= vertices.size() || c >= vertices.size())
+                continue;
+            
+            AddTriangle(vertices[a], vertices[b], vertices[c]);
+        }
+    }
+    
+    fclose(obj_file);
+    
+    Build();
+}
+
+//------------------------------------------------------------------------------------
+// Name: CollisionMesh
+// Desc: Constructor for the CollisionMesh class.
+//       Copies a mesh cooked by obj2cpp, whose BVH is already built
+//------------------------------------------------------------------------------------
+CollisionMesh::CollisionMesh(const embedded_mesh& mesh) {
+    triangles.resize(mesh.num_triangles * 3);
+    
+    for(unsigned int i = 0; i < mesh.num_triangles * 3; i++)
+        triangles[i] = vec3(mesh.triangles[i*3], mesh.triangles[i*3+1], mesh.triangles[i*3+2]);
+    
+    nodes.resize(mesh.num_nodes);
+    
+    for(unsigned int i = 0; i < mesh.num_nodes; i++) {
+        const embedded_bvh_node &node = mesh.nodes[i];
+        
+        nodes[i].bounds_min = vec3(node.bounds_min[0], node.bounds_min[1], node.bounds_min[2]);
+        nodes[i].bounds_max = vec3(node.bounds_max[0], node.bounds_max[1], node.bounds_max[2]);
+        nodes[i].first = node.first;
+        nodes[i].count = node.count;
+    }
+    
+    bounds_min = vec3(mesh.bounds_min[0], mesh.bounds_min[1], mesh.bounds_min[2]);
+    bounds_max = vec3(mesh.bounds_max[0], mesh.bounds_max[1], mesh.bounds_max[2]);
+}
+
+//----------------------------------------------------------------
+// Name: AddTriangle
+// Desc: Appends a triangle and grows the mesh bounds to fit it.
+//       Build() must be called again before querying the mesh
+//----------------------------------------------------------------
+void CollisionMesh::AddTriangle(vec3 A, vec3 B, vec3 C) {
+    triangles.push_back(A);
+    triangles.push_back(B);
+    triangles.push_back(C);
+    
+    bounds_min = glm::min(bounds_min, glm::min(A, glm::min(B, C)));
+    bounds_max = glm::max(bounds_max, glm::max(A, glm::max(B, C)));
+}
+
+//----------------------------------------------------------------
+// Name: Build
+// Desc: Builds the bounding volume hierarchy shared by all queries,
+//       using a median split along the longest centroid axis.
+//       triangle_order, if given, receives the original index of
+//       each triangle in its new place
+//----------------------------------------------------------------
+void CollisionMesh::Build(std::vector<unsigned int> *triangle_order) {
+    unsigned int n = NumTriangles();
+    
+    nodes.clear();
+    
+    if(triangle_order != nullptr)
+        triangle_order->clear();
+    
+    if(n == 0)
+        return;
+    
+    std::vector<unsigned int> order(n);
+    std::vector<vec3> centroids(n);
+    
+    for(unsigned int i = 0; i < n; i++) {
+        order[i] = i;
+        centroids[i] = (triangles[i*3] + triangles[i*3+1] + triangles[i*3+2]) * (1.0f / 3.0f);
+    }
+    
+    nodes.reserve(n * 2);
+    nodes.push_back(collision_bvh_node());
+    
+    BuildNode(0, 0, n, order, centroids);
+    
+    // Store the triangles in leaf order, so each leaf reads one contiguous run
+    std::vector<vec3> sorted(triangles.size());
+    
+    for(unsigned int i = 0; i < n; i++) {
+        sorted[i*3]   = triangles[order[i]*3];
+        sorted[i*3+1] = triangles[order[i]*3+1];
+        sorted[i*3+2] = triangles[order[i]*3+2];
+    }
+    
+    triangles.swap(sorted);
+    
+    if(triangle_order != nullptr)
+        triangle_order->swap(order);
+}
+
+void CollisionMesh::BuildNode(unsigned int node, unsigned int first, unsigned int count,
+    std::vector<unsigned int>& order, const std::vector<vec3>& centroids) {
+    vec3 node_min(FLT_MAX), node_max(-FLT_MAX);
+    vec3 centroid_min(FLT_MAX), centroid_max(-FLT_MAX);
+    
+    for(unsigned int i = first; i < first + count; i++) {
+        unsigned int tri = order[i];
+        
+        for(int k = 0; k < 3; k++) {
+            node_min = glm::min(node_min, triangles[tri*3+k]);
+            node_max = glm::max(node_max, triangles[tri*3+k]);
+        }
+        
+        centroid_min = glm::min(centroid_min, centroids[tri]);
+        centroid_max = glm::max(centroid_max, centroids[tri]);
+    }
+    
+    nodes[node].bounds_min = node_min;
+    nodes[node].bounds_max = node_max;
+    nodes[node].first = first;
+    nodes[node].count = count;
+    
+    if(count <= BVH_LEAF_SIZE)
+        return;
+    
+    vec3 extent = centroid_max - centroid_min;
+    int axis = 0;
+    
+    if(extent.y > extent.x)
+        axis = 1;
+    
+    if(extent.z > extent[axis])
+        axis = 2;
+    
+    // All centroids coincide, so there is nothing to split on
+    if(extent[axis] <= 0.0f)
+        return;
+    
+    unsigned int mid = first + count / 2;
+    
+    std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count,
+        [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+    
+    unsigned int left = (unsigned int)nodes.size();
+    
+    nodes.push_back(collision_bvh_node());
+    nodes.push_back(collision_bvh_node());
+    
+    nodes[node].first = left;
+    nodes[node].count = 0;
+    
+    BuildNode(left, first, mid - first, order, centroids);
+    BuildNode(left + 1, mid, first + count - mid, order, centroids);
+}
+
+//----------------------------------------------------------------
+// Name: SaveCooked
+// Desc: Writes the triangles and built BVH to a binary file that
+//       LoadCooked reads back without parsing or building anything
+//----------------------------------------------------------------
+bool CollisionMesh::SaveCooked(const char *filepath) const {
+    FILE *cooked_file = fopen(filepath, "wb");
+    
+    if(!cooked_file) {
+        printf("Could not write cooked collision mesh:\n%s\n", filepath);
+        return false;
+    }
+    
+    uint32_t version = COLLISION_COOKED_VERSION;
+    uint32_t num_triangles = NumTriangles();
+    uint32_t num_nodes = (uint32_t)nodes.size();
+    
+    fwrite(COLLISION_COOKED_MAGIC, 4, 1, cooked_file);
+    fwrite(&version, 4, 1, cooked_file);
+    fwrite(&num_triangles, 4, 1, cooked_file);
+    fwrite(&num_nodes, 4, 1, cooked_file);
+    fwrite(&bounds_min, sizeof(vec3), 1, cooked_file);
+    fwrite(&bounds_max, sizeof(vec3), 1, cooked_file);
+    fwrite(triangles.data(), sizeof(vec3), triangles.size(), cooked_file);
+    fwrite(nodes.data(), sizeof(collision_bvh_node), nodes.size(), cooked_file);
+    
+    bool written = !ferror(cooked_file);
+    fclose(cooked_file);
+    
+    return written;
+}
+
+//----------------------------------------------------------------
+// Name: IsValidTree
+// Desc: Checks nodes read from a file before they are traversed:
+//       leaves must stay within the triangles, and inner nodes
+//       must point forward (as Build lays them out, so there are
+//       no cycles) at a pair of nodes that exists, no deeper than
+//       the traversal stack allows
+//----------------------------------------------------------------
+static bool IsValidTree(const std::vector<collision_bvh_node>& nodes, uint32_t num_triangles) {
+    std::vector<unsigned int> depth(nodes.size(), 0);
+    
+    for(size_t i = 0; i < nodes.size(); i++) {
+        const collision_bvh_node &node = nodes[i];
+        
+        if(depth[i] >= BVH_STACK_SIZE - 1)
+            return false;
+        
+        if(node.count > 0) {
+            if(node.first > num_triangles || node.count > num_triangles - node.first)
+                return false;
+            
+            continue;
+        }
+        
+        if(node.first <= i || node.first >= nodes.size() - 1)
+            return false;
+        
+        depth[node.first] = std::max(depth[node.first], depth[i] + 1);
+        depth[node.first + 1] = std::max(depth[node.first + 1], depth[i] + 1);
+    }
+    
+    return true;
+}
+
+//----------------------------------------------------------------
+// Name: LoadCooked
+// Desc: Replaces the mesh with one written by SaveCooked. Leaves
+//       the mesh empty if the file is missing, its counts don't
+//       match its length, or its tree is malformed
+//----------------------------------------------------------------
+bool CollisionMesh::LoadCooked(const char *filepath) {
+    triangles.clear();
+    nodes.clear();
+    bounds_min = vec3(FLT_MAX);
+    bounds_max = vec3(-FLT_MAX);
+    
+    FILE *cooked_file = fopen(filepath, "rb");
+    
+    if(!cooked_file) {
+        printf("Could not open cooked collision mesh:\n%s\n", filepath);
+        return false;
+    }
+    
+    char magic[4];
+    uint32_t version, num_triangles, num_nodes;
+    vec3 cooked_min, cooked_max;
+    
+    bool valid =
+        fread(magic, 4, 1, cooked_file) == 1 && !memcmp(magic, COLLISION_COOKED_MAGIC, 4) &&
+        fread(&version, 4, 1, cooked_file) == 1 && version == COLLISION_COOKED_VERSION &&
+        fread(&num_triangles, 4, 1, cooked_file) == 1 &&
+        fread(&num_nodes, 4, 1, cooked_file) == 1 && (uint64_t)num_nodes <= 2 * (uint64_t)num_triangles &&
+        (num_nodes == 0) == (num_triangles == 0) &&
+        fread(&cooked_min, sizeof(vec3), 1, cooked_file) == 1 &&
+        fread(&cooked_max, sizeof(vec3), 1, cooked_file) == 1;
+    
+    // The counts must describe exactly the rest of the file, before anything is allocated for them
+    if(valid) {
+        uint64_t data_bytes = (uint64_t)num_triangles * 3 * sizeof(vec3) + (uint64_t)num_nodes * sizeof(collision_bvh_node);
+        
+        long data_start = ftell(cooked_file);
+        fseek(cooked_file, 0, SEEK_END);
+        long file_end = ftell(cooked_file);
+        fseek(cooked_file, data_start, SEEK_SET);
+        
+        valid = data_start >= 0 && file_end >= data_start && (uint64_t)(file_end - data_start) == data_bytes;
+    }
+    
+    if(valid) {
+        triangles.resize((size_t)num_triangles * 3);
+        nodes.resize(num_nodes);
+        
+        valid =
+            fread(triangles.data(), sizeof(vec3), triangles.size(), cooked_file) == triangles.size() &&
+            fread(nodes.data(), sizeof(collision_bvh_node), nodes.size(), cooked_file) == nodes.size() &&
+            IsValidTree(nodes, num_triangles);
+    }
+    
+    fclose(cooked_file);
+    
+    if(!valid) {
+        printf("Invalid cooked collision mesh:\n%s\n", filepath);
+        
+        triangles.clear();
+        nodes.clear();
+        return false;
+    }
+    
+    bounds_min = cooked_min;
+    bounds_max = cooked_max;
+    
+    return true;
+}
+
+//----------------------------------------------------------------
+// Name: IsIntersectingRayBox
+// Desc: Slab test of a ray (given by its reciprocal direction)
+//       against an axis-aligned box, clipped to [0, max_t]
+//----------------------------------------------------------------
+static inline bool IsIntersectingRayBox(vec3 O, vec3 inv_D, vec3 box_min, vec3 box_max, float max_t) {
+    float tx1 = (box_min.x - O.x) * inv_D.x;
+    float tx2 = (box_max.x - O.x) * inv_D.x;
+    float ty1 = (box_min.y - O.y) * inv_D.y;
+    float ty2 = (box_max.y - O.y) * inv_D.y;
+    float tz1 = (box_min.z - O.z) * inv_D.z;
+    float tz2 = (box_max.z - O.z) * inv_D.z;
+    
+    float t_enter = fmaxf(fmaxf(fminf(tx1, tx2), fminf(ty1, ty2)), fmaxf(fminf(tz1, tz2), 0.0f));
+    float t_exit  = fminf(fminf(fmaxf(tx1, tx2), fmaxf(ty1, ty2)), fminf(fmaxf(tz1, tz2), max_t));
+    
+    return t_enter <= t_exit;
+}
+
+static inline vec3 ReciprocalDirection(vec3 D) {
+    return vec3(1.0f / D.x, 1.0f / D.y, 1.0f / D.z);
+}
+
+//----------------------------------------------------------------
+// Name: IsOverlappingBoxes
+// Desc: Axis-aligned box overlap test, touching counts as overlapping
+//----------------------------------------------------------------
+static inline bool IsOverlappingBoxes(vec3 a_min, vec3 a_max, vec3 b_min, vec3 b_max) {
+    return !(a_max.x < b_min.x || a_min.x > b_max.x ||
+             a_max.y < b_min.y || a_min.y > b_max.y ||
+             a_max.z < b_min.z || a_min.z > b_max.z);
+}
+
+//----------------------------------------------------------------
+// Name: VisitLeavesInBox
+// Desc: Calls visit(node index) for every BVH leaf overlapping the
+//       box, in the same depth-first order every time
+//----------------------------------------------------------------
+template<typename Visitor>
+static void VisitLeavesInBox(const std::vector<collision_bvh_node>& nodes, vec3 query_min, vec3 query_max, Visitor visit) {
+    if(nodes.empty())
+        return;
+    
+    unsigned int stack[BVH_STACK_SIZE];
+    unsigned int stack_size = 0;
+    
+    stack[stack_size++] = 0;
+    
+    while(stack_size > 0) {
+        unsigned int index = stack[--stack_size];
+        const collision_bvh_node &node = nodes[index];
+        
+        if(!IsOverlappingBoxes(query_min, query_max, node.bounds_min, node.bounds_max))
+            continue;
+        
+        if(node.count == 0) {
+            DEBUG_DRAW_BOX(DEBUG_DRAW_BVH, node.bounds_min, node.bounds_max, DEBUG_COLOR_BVH_INNER);
+            
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = node.first + 1;
+            continue;
+        }
+        
+        DEBUG_DRAW_BOX(DEBUG_DRAW_BVH, node.bounds_min, node.bounds_max, DEBUG_COLOR_BVH_LEAF);
+        
+        visit(index);
+    }
+}
+
+//----------------------------------------------------------------
+// Name: QuerySphereNodes
+// Desc: Appends every triangle whose BVH leaf overlaps the
+//       bounding box of the sphere to any push_back container
+//----------------------------------------------------------------
+template<typename Container>
+static void QuerySphereNodes(const std::vector<collision_bvh_node>& nodes, vec3 P, float r, Container& candidates) {
+    VisitLeavesInBox(nodes, P - vec3(r), P + vec3(r), [&](unsigned int leaf) {
+        const collision_bvh_node &node = nodes[leaf];
+        
+        for(unsigned int i = node.first; i < node.first + node.count; i++)
+            candidates.push_back(i);
+    });
+}
+
+//----------------------------------------------------------------
+// Name: QuerySphere
+// Desc: Appends every triangle whose BVH leaf overlaps the
+//       bounding box of the sphere to the candidate list
+//----------------------------------------------------------------
+void CollisionMesh::QuerySphere(vec3 P, float r, std::vector<unsigned int>& candidates) const {
+    QuerySphereNodes(nodes, P, r, candidates);
+}
+
+void CollisionMesh::QuerySphere(vec3 P, float r, ArenaArray<unsigned int>& candidates) const {
+    QuerySphereNodes(nodes, P, r, candidates);
+}
+
+//----------------------------------------------------------------
+// Name: QueryBoxLeaves
+// Desc: Appends the index of every BVH leaf overlapping the box.
+//       Gathered once for a box around a slow-moving sphere, the
+//       leaves can answer its queries for the next few frames
+//       through QuerySphereLeaves, without walking the tree
+//----------------------------------------------------------------
+void CollisionMesh::QueryBoxLeaves(vec3 box_min, vec3 box_max, std::vector<unsigned int>& leaves) const {
+    VisitLeavesInBox(nodes, box_min, box_max, [&](unsigned int leaf) {
+        leaves.push_back(leaf);
+    });
+}
+
+//----------------------------------------------------------------
+// Name: QuerySphereLeaves
+// Desc: QuerySphere over a set of leaves from QueryBoxLeaves. When
+//       the box contains the bounding box of the sphere, the
+//       candidates and their order are exactly those QuerySphere
+//       would find
+//----------------------------------------------------------------
+void CollisionMesh::QuerySphereLeaves(vec3 P, float r, const unsigned int *leaves, unsigned int num_leaves,
+    ArenaArray<unsigned int>& candidates) const {
+    vec3 query_min = P - vec3(r);
+    vec3 query_max = P + vec3(r);
+    
+    for(unsigned int l = 0; l < num_leaves; l++) {
+        const collision_bvh_node &node = nodes[leaves[l]];
+        
+        if(!IsOverlappingBoxes(query_min, query_max, node.bounds_min, node.bounds_max))
+            continue;
+        
+        DEBUG_DRAW_BOX(DEBUG_DRAW_BVH, node.bounds_min, node.bounds_max, DEBUG_COLOR_BVH_LEAF);
+        
+        for(unsigned int i = node.first; i < node.first + node.count; i++)
+            candidates.push_back(i);
+    }
+}
+
+//----------------------------------------------------------------
+// Name: RayCast
+// Desc: Finds the closest triangle hit by the ray within max_t
+//----------------------------------------------------------------
+bool CollisionMesh::RayCast(RayHit& hit, vec3 O, vec3 D, float max_t) const {
+    hit.t = max_t;
+    hit.triangle = COLLISION_NO_TRIANGLE;
+    
+    if(nodes.empty())
+        return false;
+    
+    vec3 inv_D = ReciprocalDirection(D);
+    
+    unsigned int stack[BVH_STACK_SIZE];
+    unsigned int stack_size = 0;
+    
+    stack[stack_size++] = 0;
+    
+    while(stack_size > 0) {
+        const collision_bvh_node &node = nodes[stack[--stack_size]];
+        
+        if(!IsIntersectingRayBox(O, inv_D, node.bounds_min, node.bounds_max, hit.t))
+            continue;
+        
+        if(node.count == 0) {
+            // Visit the child nearer along the ray first, so hit.t shrinks sooner
+            const collision_bvh_node &left = nodes[node.first];
+            const collision_bvh_node &right = nodes[node.first + 1];
+            
+            bool left_first = dot(left.bounds_min + left.bounds_max, D) <= dot(right.bounds_min + right.bounds_max, D);
+            
+            stack[stack_size++] = left_first ? node.first + 1 : node.first;
+            stack[stack_size++] = left_first ? node.first : node.first + 1;
+            continue;
+        }
+        
+        for(unsigned int i = node.first; i < node.first + node.count; i++) {
+            float t;
+            
+            if(IsIntersectingRayTriangle(t, O, D, triangles[i*3], triangles[i*3+1], triangles[i*3+2]) && t < hit.t) {
+                hit.t = t;
+                hit.triangle = i;
+            }
+        }
+    }
+    
+    if(hit.triangle == COLLISION_NO_TRIANGLE)
+        return false;
+    
+    // Face the normal back towards the ray origin
+    const vec3 *tri = &triangles[hit.triangle*3];
+    
+    hit.normal = normalize(cross(tri[1] - tri[0], tri[2] - tri[0]));
+    
+    if(dot(hit.normal, D) > 0.0f)
+        hit.normal = -hit.normal;
+    
+    return true;
+}
+
+//----------------------------------------------------------------
+// Name: RayCastAny
+// Desc: Returns as soon as any triangle blocks the ray within
+//       max_t, e.g. for line of sight checks
+//----------------------------------------------------------------
+bool CollisionMesh::RayCastAny(vec3 O, vec3 D, float max_t) const {
+    if(nodes.empty())
+        return false;
+    
+    vec3 inv_D = ReciprocalDirection(D);
+    
+    unsigned int stack[BVH_STACK_SIZE];
+    unsigned int stack_size = 0;
+    
+    stack[stack_size++] = 0;
+    
+    while(stack_size > 0) {
+        const collision_bvh_node &node = nodes[stack[--stack_size]];
+        
+        if(!IsIntersectingRayBox(O, inv_D, node.bounds_min, node.bounds_max, max_t))
+            continue;
+        
+        if(node.count == 0) {
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = node.first + 1;
+            continue;
+        }
+        
+        for(unsigned int i = node.first; i < node.first + node.count; i++) {
+            float t;
+            
+            if(IsIntersectingRayTriangle(t, O, D, triangles[i*3], triangles[i*3+1], triangles[i*3+2]) && t <= max_t)
+                return true;
+        }
+    }
+    
+    return false;
+}
+
+//----------------------------------------------------------------
+// Name: SphereCast
+// Desc: Sweeps a sphere along the ray and finds the first
+//       triangle it touches within max_t
+//----------------------------------------------------------------
+bool CollisionMesh::SphereCast(RayHit& hit, vec3 O, vec3 D, float r, float max_t) const {
+    hit.t = max_t;
+    hit.triangle = COLLISION_NO_TRIANGLE;
+    
+    if(nodes.empty())
+        return false;
+    
+    vec3 inv_D = ReciprocalDirection(D);
+    vec3 grow(r);
+    
+    unsigned int stack[BVH_STACK_SIZE];
+    unsigned int stack_size = 0;
+    
+    stack[stack_size++] = 0;
+    
+    while(stack_size > 0) {
+        const collision_bvh_node &node = nodes[stack[--stack_size]];
+        
+        // Grow each box by the radius instead of sweeping the sphere
+        if(!IsIntersectingRayBox(O, inv_D, node.bounds_min - grow, node.bounds_max + grow, hit.t))
+            continue;
+        
+        if(node.count == 0) {
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = node.first + 1;
+            continue;
+        }
+        
+        for(unsigned int i = node.first; i < node.first + node.count; i++) {
+            RayHit tri_hit;
+            
+            if(IsIntersectingSphereCastTriangle(tri_hit, O, D, r, hit.t, triangles[i*3], triangles[i*3+1], triangles[i*3+2]) &&
+               (hit.triangle == COLLISION_NO_TRIANGLE || tri_hit.t < hit.t)) {
+                hit.t = tri_hit.t;
+                hit.normal = tri_hit.normal;
+                hit.triangle = i;
+            }
+        }
+    }
+    
+    return hit.triangle != COLLISION_NO_TRIANGLE;
+}
+
+//----------------------------------------------------------------
+// Name: RayCastPacket
+// Desc: Closest-hit casts for many coherent rays at once. Rays are
+//       traced in packets that walk the BVH together, so each node
+//       is fetched once per packet rather than once per ray.
+//       Misses are reported with triangle == COLLISION_NO_TRIANGLE
+//----------------------------------------------------------------
+void CollisionMesh::RayCastPacket(RayHit *hits, const vec3 *origins, const vec3 *directions, float max_t, unsigned int count) const {
+    for(unsigned int i = 0; i < count; i += RAY_PACKET_SIZE) {
+        unsigned int chunk = std::min(count - i, (unsigned int)RAY_PACKET_SIZE);
+        
+        RayCastPacketChunk(hits + i, origins + i, directions + i, max_t, chunk);
+    }
+}
+
+void CollisionMesh::RayCastPacketChunk(RayHit *hits, const vec3 *origins, const vec3 *directions, float max_t, unsigned int count) const {
+    vec3 inv_D[RAY_PACKET_SIZE];
+    
+    for(unsigned int r = 0; r < count; r++) {
+        inv_D[r] = ReciprocalDirection(directions[r]);
+        
+        hits[r].t = max_t;
+        hits[r].triangle = COLLISION_NO_TRIANGLE;
+    }
+    
+    if(nodes.empty())
+        return;
+    
+    unsigned int stack[BVH_STACK_SIZE];
+    unsigned int stack_size = 0;
+    
+    stack[stack_size++] = 0;
+    
+    while(stack_size > 0) {
+        const collision_bvh_node &node = nodes[stack[--stack_size]];
+        
+        // Inner nodes are entered as soon as one ray of the packet reaches them
+        if(node.count == 0) {
+            for(unsigned int r = 0; r < count; r++) {
+                if(IsIntersectingRayBox(origins[r], inv_D[r], node.bounds_min, node.bounds_max, hits[r].t)) {
+                    stack[stack_size++] = node.first;
+                    stack[stack_size++] = node.first + 1;
+                    break;
+                }
+            }
+            
+            continue;
+        }
+        
+        // Leaves are tested only against the rays that reach them
+        for(unsigned int r = 0; r < count; r++) {
+            if(!IsIntersectingRayBox(origins[r], inv_D[r], node.bounds_min, node.bounds_max, hits[r].t))
+                continue;
+            
+            for(unsigned int i = node.first; i < node.first + node.count; i++) {
+                float t;
+                
+                if(IsIntersectingRayTriangle(t, origins[r], directions[r], triangles[i*3], triangles[i*3+1], triangles[i*3+2]) && t < hits[r].t) {
+                    hits[r].t = t;
+                    hits[r].triangle = i;
+                }
+            }
+        }
+    }
+    
+    for(unsigned int r = 0; r < count; r++) {
+        if(hits[r].triangle == COLLISION_NO_TRIANGLE)
+            continue;
+        
+        const vec3 *tri = &triangles[hits[r].triangle*3];
+        
+        hits[r].normal = normalize(cross(tri[1] - tri[0], tri[2] - tri[0]));
+        
+        if(dot(hits[r].normal, directions[r]) > 0.0f)
+            hits[r].normal = -hits[r].normal;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "common.h"
+#include "arena.h"
+#include "collision.h"
+#include "embeddedmesh.h"
+
+// Most triangles stored in a single BVH leaf
+#define BVH_LEAF_SIZE 4
+
+// Rays traced together by RayCastPacket
+#define RAY_PACKET_SIZE 16
+
+typedef struct {
+    vec3 bounds_min;
+    vec3 bounds_max;
+    
+    unsigned int first; // Left child for inner nodes, first triangle for leaves
+    unsigned int count; // Number of triangles, 0 for inner nodes
+} collision_bvh_node;
+
+class CollisionMesh {
+public:
+    CollisionMesh();
+    CollisionMesh(const char *directory, const char *filename);
+    CollisionMesh(const embedded_mesh& mesh);
+    
+    void AddTriangle(vec3 A, vec3 B, vec3 C);
+    void Build(std::vector<unsigned int> *triangle_order = nullptr);
+    
+    // Binary files of the triangles and built BVH (see tools/chunkcook.cpp)
+    bool SaveCooked(const char *filepath) const;
+    bool LoadCooked(const char *filepath);
+    
+    unsigned int NumTriangles() const { return (unsigned int)(triangles.size() / 3); }
+    
+    // Overlap query
+    void QuerySphere(vec3 P, float r, std::vector<unsigned int>& candidates) const;
+    void QuerySphere(vec3 P, float r, ArenaArray<unsigned int>& candidates) const;
+    
+    // Overlap query split in two, so the leaves found around a moving sphere can be reused
+    void QueryBoxLeaves(vec3 box_min, vec3 box_max, std::vector<unsigned int>& leaves) const;
+    void QuerySphereLeaves(vec3 P, float r, const unsigned int *leaves, unsigned int num_leaves,
+        ArenaArray<unsigned int>& candidates) const;
+    
+    // Ray and shape-cast queries. Directions must be normalized
+    bool RayCast(RayHit& hit, vec3 O, vec3 D, float max_t) const;
+    bool RayCastAny(vec3 O, vec3 D, float max_t) const;
+    bool SphereCast(RayHit& hit, vec3 O, vec3 D, float r, float max_t) const;
+    
+    void RayCastPacket(RayHit *hits, const vec3 *origins, const vec3 *directions, float max_t, unsigned int count) const;
+    
+    // Triangle soup, three consecutive vertices per triangle.
+    // Build() reorders the triangles to match the BVH leaves
+    std::vector<vec3> triangles;
+    
+    std::vector<collision_bvh_node> nodes;
+    
+    vec3 bounds_min;
+    vec3 bounds_max;
+private:
+    void BuildNode(unsigned int node, unsigned int first, unsigned int count,
+        std::vector<unsigned int>& order, const std::vector<vec3>& centroids);
+    
+    void RayCastPacketChunk(RayHit *hits, const vec3 *origins, const vec3 *directions, float max_t, unsigned int count) const;
+};
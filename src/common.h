@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using glm::vec2;
+using glm::vec3;
+using glm::vec4;
+using glm::mat4;
+
+using glm::radians;
+
+using glm::dot;
+using glm::cross;
+using glm::inverse;
+
+using glm::translate;
+using glm::rotate;
+using glm::scale;
+
+using glm::perspective;
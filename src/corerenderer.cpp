@@ -0,0 +1,578 @@
+#include "corerenderer.h"
+
+#include <cstddef>
+
+#include <glm/gtc/constants.hpp>
+
+// Uniform block binding points
+#define FRAME_BINDING    0
+#define MATERIAL_BINDING 1
+
+// Vertex attribute locations
+#define ATTRIB_POSITION  0
+#define ATTRIB_NORMAL    1
+#define ATTRIB_UV        2
+#define ATTRIB_INSTANCE  3
+#define ATTRIB_COLOR     4
+
+// Tessellation of the instanced sphere, matching the old gluSphere calls
+#define SPHERE_SLICES 20
+#define SPHERE_STACKS 20
+
+// std140 layout of the Material block
+typedef struct {
+    vec4 diffuse;
+    vec4 ambient;
+    vec4 specular;
+    vec4 params; // x = textured, y = shininess
+} core_material_block;
+
+typedef struct {
+    vec3 position;
+    vec3 normal;
+    vec2 uv;
+} core_mesh_vertex;
+
+static const char *common_glsl =
+    "#version 330 core\n"
+    "layout(std140) uniform Frame {\n"
+    "    mat4 proj;\n"
+    "    mat4 view;\n"
+    "};\n"
+    "layout(std140) uniform Material {\n"
+    "    vec4 diffuse;\n"
+    "    vec4 ambient;\n"
+    "    vec4 specular;\n"
+    "    vec4 params;\n"
+    "};\n";
+
+static const char *mesh_vertex_glsl =
+    "layout(location = 0) in vec3 in_position;\n"
+    "layout(location = 1) in vec3 in_normal;\n"
+    "layout(location = 2) in vec2 in_uv;\n"
+    "out vec3 v_normal;\n"
+    "out vec2 v_uv;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    v_normal = mat3(view) * in_normal;\n"
+    "    v_uv = in_uv;\n"
+    "    v_color = vec4(1.0);\n"
+    "    gl_Position = proj * view * vec4(in_position, 1.0);\n"
+    "}\n";
+
+static const char *sphere_vertex_glsl =
+    "layout(location = 0) in vec3 in_position;\n"
+    "layout(location = 3) in vec4 in_instance;\n"
+    "layout(location = 4) in vec4 in_color;\n"
+    "out vec3 v_normal;\n"
+    "out vec2 v_uv;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    v_normal = mat3(view) * in_position;\n"
+    "    v_uv = vec2(0.0);\n"
+    "    v_color = in_color;\n"
+    "    gl_Position = proj * view * vec4(in_instance.xyz + in_position * in_instance.w, 1.0);\n"
+    "}\n";
+
+// Matches the fixed-function setup: a white directional light fixed to the
+// camera at (1, 1, 1), infinite viewer, texture modulating the lit colour
+static const char *lit_fragment_glsl =
+    "uniform sampler2D tex;\n"
+    "in vec3 v_normal;\n"
+    "in vec2 v_uv;\n"
+    "in vec4 v_color;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "    const vec3 light_dir = vec3(0.57735027);\n"
+    "    vec3 N = normalize(v_normal);\n"
+    "    float n_dot_l = max(dot(N, light_dir), 0.0);\n"
+    "    vec3 H = normalize(light_dir + vec3(0.0, 0.0, 1.0));\n"
+    "    float spec = n_dot_l > 0.0 ? pow(max(dot(N, H), 0.0), params.y) : 0.0;\n"
+    "    vec4 base = diffuse * v_color;\n"
+    "    vec4 color = vec4(clamp(ambient.rgb + base.rgb * n_dot_l + specular.rgb * spec, 0.0, 1.0), base.a);\n"
+    "    if(params.x > 0.5)\n"
+    "        color *= texture(tex, v_uv);\n"
+    "    frag_color = color;\n"
+    "}\n";
+
+static const char *skybox_vertex_glsl =
+    "layout(location = 0) in vec3 in_position;\n"
+    "out vec3 v_dir;\n"
+    "void main() {\n"
+    "    v_dir = in_position;\n"
+    "    gl_Position = proj * vec4(mat3(view) * in_position, 1.0);\n"
+    "}\n";
+
+static const char *line_vertex_glsl =
+    "layout(location = 0) in vec3 in_position;\n"
+    "layout(location = 4) in vec4 in_color;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    v_color = in_color;\n"
+    "    gl_Position = proj * view * vec4(in_position, 1.0);\n"
+    "}\n";
+
+static const char *line_fragment_glsl =
+    "in vec4 v_color;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "    frag_color = v_color;\n"
+    "}\n";
+
+static const char *skybox_fragment_glsl =
+    "uniform samplerCube cubemap;\n"
+    "in vec3 v_dir;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "    frag_color = texture(cubemap, v_dir);\n"
+    "}\n";
+
+//------------------------------------------------------------
+// Name: CompileShader
+// Desc: Compiles one shader stage from the shared prelude and
+//       the stage's own source, printing the log on failure
+//------------------------------------------------------------
+static GLuint CompileShader(GLenum type, const char *source) {
+    const char *sources[] = { common_glsl, source };
+    
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 2, sources, NULL);
+    glCompileShader(shader);
+    
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    
+    if(!status) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("ERROR: Failed to compile shader:\n%s\n", log);
+    }
+    
+    return shader;
+}
+
+//------------------------------------------------------------
+// Name: CreateProgram
+// Desc: Links a program and binds its uniform blocks and
+//       sampler (if any) to the fixed binding points used here
+//------------------------------------------------------------
+static GLuint CreateProgram(const char *vertex_source, const char *fragment_source, const char *sampler) {
+    GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER, fragment_source);
+    
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    
+    if(!status) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        printf("ERROR: Failed to link shader program:\n%s\n", log);
+    }
+    
+    GLuint frame_index = glGetUniformBlockIndex(program, "Frame");
+    GLuint material_index = glGetUniformBlockIndex(program, "Material");
+    
+    if(frame_index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, frame_index, FRAME_BINDING);
+    
+    if(material_index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, material_index, MATERIAL_BINDING);
+    
+    if(sampler != NULL) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, sampler), 0);
+        glUseProgram(0);
+    }
+    
+    return program;
+}
+
+//------------------------------------------------------------
+// Name: CoreRenderer
+// Desc: Constructor for the CoreRenderer class. Requires an
+//       OpenGL 3.3 (core profile) context
+//------------------------------------------------------------
+CoreRenderer::CoreRenderer(int width, int height) {
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    
+    glEnable(GL_MULTISAMPLE);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    
+    mesh_program = CreateProgram(mesh_vertex_glsl, lit_fragment_glsl, "tex");
+    sphere_program = CreateProgram(sphere_vertex_glsl, lit_fragment_glsl, "tex");
+    skybox_program = CreateProgram(skybox_vertex_glsl, skybox_fragment_glsl, "cubemap");
+    line_program = CreateProgram(line_vertex_glsl, line_fragment_glsl, NULL);
+    
+    // Each material gets its own slot, aligned for glBindBufferRange
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    material_stride = ((sizeof(core_material_block) + alignment - 1) / alignment) * alignment;
+    
+    glGenBuffers(1, &frame_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(mat4) * 2, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frame_buffer);
+    
+    // Shared sphere material; the diffuse colour comes from each instance
+    core_material_block sphere_material;
+    sphere_material.diffuse = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    sphere_material.ambient = vec4(0.0f, 0.1f, 0.2f, 1.0f);
+    sphere_material.specular = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    sphere_material.params = vec4(0.0f, 8.0f, 0.0f, 0.0f);
+    
+    glGenBuffers(1, &sphere_material_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, sphere_material_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(sphere_material), &sphere_material, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    
+    // Build the unit sphere; positions double as normals
+    std::vector<vec3> sphere_vertices;
+    std::vector<unsigned short> sphere_indices;
+    
+    for(int stack = 0; stack <= SPHERE_STACKS; stack++) {
+        float phi = glm::pi<float>() * stack / SPHERE_STACKS;
+        
+        for(int slice = 0; slice <= SPHERE_SLICES; slice++) {
+            float theta = 2.0f * glm::pi<float>() * slice / SPHERE_SLICES;
+            sphere_vertices.push_back(vec3(sinf(phi) * sinf(theta), cosf(phi), sinf(phi) * cosf(theta)));
+        }
+    }
+    
+    for(int stack = 0; stack < SPHERE_STACKS; stack++) {
+        for(int slice = 0; slice < SPHERE_SLICES; slice++) {
+            unsigned short a = stack * (SPHERE_SLICES + 1) + slice;
+            unsigned short b = a + SPHERE_SLICES + 1;
+            
+            sphere_indices.push_back(a);
+            sphere_indices.push_back(b);
+            sphere_indices.push_back(a + 1);
+            
+            sphere_indices.push_back(a + 1);
+            sphere_indices.push_back(b);
+            sphere_indices.push_back(b + 1);
+        }
+    }
+    
+    sphere_index_count = (GLsizei)sphere_indices.size();
+    
+    glGenVertexArrays(1, &sphere_vertex_array);
+    glBindVertexArray(sphere_vertex_array);
+    
+    glGenBuffers(1, &sphere_vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, sphere_vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sphere_vertices.size() * sizeof(vec3), sphere_vertices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0);
+    
+    glGenBuffers(1, &sphere_index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere_index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere_indices.size() * sizeof(unsigned short), sphere_indices.data(), GL_STATIC_DRAW);
+    
+    // Per-instance position/radius and colour
+    glGenBuffers(1, &sphere_instance_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, sphere_instance_buffer);
+    
+    glEnableVertexAttribArray(ATTRIB_INSTANCE);
+    glVertexAttribPointer(ATTRIB_INSTANCE, 4, GL_FLOAT, GL_FALSE, sizeof(sphere_instance), (void *)0);
+    glVertexAttribDivisor(ATTRIB_INSTANCE, 1);
+    
+    glEnableVertexAttribArray(ATTRIB_COLOR);
+    glVertexAttribPointer(ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(sphere_instance), (void *)offsetof(sphere_instance, color));
+    glVertexAttribDivisor(ATTRIB_COLOR, 1);
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    glGenVertexArrays(1, &skybox_vertex_array);
+    skybox_vertex_buffer = 0;
+    
+    glGenVertexArrays(1, &line_vertex_array);
+    glBindVertexArray(line_vertex_array);
+    
+    glGenBuffers(1, &line_vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, line_vertex_buffer);
+    
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(debug_vertex), (void *)offsetof(debug_vertex, position));
+    glEnableVertexAttribArray(ATTRIB_COLOR);
+    glVertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(debug_vertex), (void *)offsetof(debug_vertex, color));
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    Resize(width, height);
+}
+
+//------------------------------------------------------------
+// Name: Resize
+// Desc: Updates the viewport and projection matrix
+//------------------------------------------------------------
+void CoreRenderer::Resize(int width, int height) {
+    glViewport(0, 0, width, height);
+    
+    proj = perspective(45.0f, (float)width/height, 0.1f, 1000.0f);
+}
+
+//------------------------------------------------------------
+// Name: BeginFrame
+// Desc: Clears the frame and uploads the frame's matrices
+//------------------------------------------------------------
+void CoreRenderer::BeginFrame(const mat4& frame_view) {
+    view = frame_view;
+    
+    memset(&stats, 0, sizeof(stats));
+    
+    mat4 matrices[2] = { proj, view };
+    
+    COUNTED_STATE(glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer));
+    COUNTED_STATE(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(matrices), matrices));
+    COUNTED_STATE(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+    
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+//------------------------------------------------------------
+// Name: DrawSkybox
+// Desc: Draws the skybox behind everything, from the vertex
+//       buffer and cubemap the Skybox already owns
+//------------------------------------------------------------
+void CoreRenderer::DrawSkybox(Skybox *skybox) {
+    COUNTED_STATE(glBindVertexArray(skybox_vertex_array));
+    
+    if(skybox_vertex_buffer != skybox->GetVertexBuffer()) {
+        skybox_vertex_buffer = skybox->GetVertexBuffer();
+        
+        COUNTED_STATE(glBindBuffer(GL_ARRAY_BUFFER, skybox_vertex_buffer));
+        COUNTED_STATE(glEnableVertexAttribArray(ATTRIB_POSITION));
+        COUNTED_STATE(glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0));
+        COUNTED_STATE(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    }
+    
+    // Don't write to the depth buffer! (Keeps skybox behind everything if drawn first)
+    COUNTED_STATE(glDisable(GL_DEPTH_TEST));
+    COUNTED_STATE(glDepthMask(false));
+    
+    COUNTED_STATE(glUseProgram(skybox_program));
+    
+    COUNTED_STATE(glActiveTexture(GL_TEXTURE0));
+    COUNTED_STATE(glBindTexture(GL_TEXTURE_CUBE_MAP, skybox->GetTexture()));
+    
+    glDrawArrays(GL_TRIANGLES, 0, skybox->GetVertexCount());
+    
+    COUNTED_STATE(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+    
+    COUNTED_STATE(glDepthMask(true));
+    COUNTED_STATE(glEnable(GL_DEPTH_TEST));
+    
+    COUNTED_STATE(glBindVertexArray(0));
+    
+    stats.draw_calls += 1;
+    stats.triangles += skybox->GetVertexCount() / 3;
+}
+
+//------------------------------------------------------------
+// Name: UploadStaticMesh
+// Desc: Flattens a mesh into one interleaved vertex buffer with
+//       a contiguous range per submesh, and its materials into
+//       a uniform buffer. Done once, the first time it is drawn
+//------------------------------------------------------------
+core_static_mesh *CoreRenderer::UploadStaticMesh(StaticMesh *mesh) {
+    core_static_mesh &gpu_mesh = meshes[mesh];
+    
+    std::vector<core_mesh_vertex> vertices;
+    
+    for(unsigned int i = 0; i < mesh->groups.size(); i++) {
+        for(unsigned int j = 0; j < mesh->groups[i].submeshes.size(); j++) {
+            const static_mesh_submesh &submesh = mesh->groups[i].submeshes[j];
+            const static_mesh_material &material = mesh->materials[submesh.material_index];
+            
+            core_mesh_range range;
+            range.first = (GLint)vertices.size();
+            range.count = submesh.num_faces * 3;
+            range.material_index = submesh.material_index;
+            range.gl_tex_id = material.texture != nullptr ? material.gl_tex_id : 0;
+            
+            for(unsigned int k = 0; k < submesh.num_faces * 3; k++) {
+                core_mesh_vertex vertex;
+                vertex.position = mesh->vertices[submesh.vertex_indices[k]];
+                vertex.normal = mesh->normals[submesh.normal_indices[k]];
+                vertex.uv = mesh->uvs[submesh.uv_indices[k]];
+                
+                vertices.push_back(vertex);
+            }
+            
+            gpu_mesh.ranges.push_back(range);
+        }
+    }
+    
+    glGenVertexArrays(1, &gpu_mesh.vertex_array);
+    glBindVertexArray(gpu_mesh.vertex_array);
+    
+    glGenBuffers(1, &gpu_mesh.vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu_mesh.vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(core_mesh_vertex), vertices.data(), GL_STATIC_DRAW);
+    
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(core_mesh_vertex), (void *)offsetof(core_mesh_vertex, position));
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
+    glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(core_mesh_vertex), (void *)offsetof(core_mesh_vertex, normal));
+    glEnableVertexAttribArray(ATTRIB_UV);
+    glVertexAttribPointer(ATTRIB_UV, 2, GL_FLOAT, GL_FALSE, sizeof(core_mesh_vertex), (void *)offsetof(core_mesh_vertex, uv));
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    // One aligned slot per material, selected with glBindBufferRange when drawing
+    std::vector<unsigned char> material_data(mesh->materials.size() * material_stride + 1);
+    
+    for(unsigned int i = 0; i < mesh->materials.size(); i++) {
+        const static_mesh_material &material = mesh->materials[i];
+        
+        core_material_block block;
+        block.diffuse = material.diffuse;
+        block.ambient = material.ambient;
+        block.specular = material.specular;
+        block.params = vec4(material.texture != nullptr ? 1.0f : 0.0f, 8.0f, 0.0f, 0.0f);
+        
+        memcpy(&material_data[i * material_stride], &block, sizeof(block));
+    }
+    
+    glGenBuffers(1, &gpu_mesh.material_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, gpu_mesh.material_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, material_data.size(), material_data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    
+    return &gpu_mesh;
+}
+
+//------------------------------------------------------------
+// Name: ReleaseStaticMesh
+// Desc: Frees the GPU copy of a mesh made by UploadStaticMesh
+//------------------------------------------------------------
+void CoreRenderer::ReleaseStaticMesh(StaticMesh *mesh) {
+    std::map<StaticMesh *, core_static_mesh>::iterator it = meshes.find(mesh);
+    
+    if(it == meshes.end())
+        return;
+    
+    glDeleteVertexArrays(1, &it->second.vertex_array);
+    glDeleteBuffers(1, &it->second.vertex_buffer);
+    glDeleteBuffers(1, &it->second.material_buffer);
+    
+    meshes.erase(it);
+}
+
+//------------------------------------------------------------
+// Name: DrawStaticMesh
+// Desc: Draws a static mesh at the world origin, one draw call
+//       per submesh
+//------------------------------------------------------------
+void CoreRenderer::DrawStaticMesh(StaticMesh *mesh) {
+    std::map<StaticMesh *, core_static_mesh>::iterator it = meshes.find(mesh);
+    core_static_mesh *gpu_mesh = it != meshes.end() ? &it->second : UploadStaticMesh(mesh);
+    
+    COUNTED_STATE(glUseProgram(mesh_program));
+    COUNTED_STATE(glBindVertexArray(gpu_mesh->vertex_array));
+    COUNTED_STATE(glActiveTexture(GL_TEXTURE0));
+    
+    for(unsigned int i = 0; i < gpu_mesh->ranges.size(); i++) {
+        const core_mesh_range &range = gpu_mesh->ranges[i];
+        
+        COUNTED_STATE(glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BINDING, gpu_mesh->material_buffer,
+            range.material_index * material_stride, sizeof(core_material_block)));
+        
+        COUNTED_STATE(glBindTexture(GL_TEXTURE_2D, range.gl_tex_id));
+        
+        glDrawArrays(GL_TRIANGLES, range.first, range.count);
+        
+        stats.draw_calls += 1;
+        stats.triangles += range.count / 3;
+    }
+    
+    COUNTED_STATE(glBindTexture(GL_TEXTURE_2D, 0));
+    COUNTED_STATE(glBindVertexArray(0));
+}
+
+//------------------------------------------------------------
+// Name: DrawSpheres
+// Desc: Draws every sphere with a single instanced draw call
+//------------------------------------------------------------
+void CoreRenderer::DrawSpheres(const sphere_instance *spheres, unsigned int count) {
+    if(count == 0)
+        return;
+    
+    // Orphan and refill the instance buffer each frame
+    COUNTED_STATE(glBindBuffer(GL_ARRAY_BUFFER, sphere_instance_buffer));
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(sphere_instance), spheres, GL_STREAM_DRAW);
+    COUNTED_STATE(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    
+    COUNTED_STATE(glUseProgram(sphere_program));
+    COUNTED_STATE(glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BINDING, sphere_material_buffer));
+    
+    COUNTED_STATE(glBindVertexArray(sphere_vertex_array));
+    glDrawElementsInstanced(GL_TRIANGLES, sphere_index_count, GL_UNSIGNED_SHORT, (void *)0, count);
+    COUNTED_STATE(glBindVertexArray(0));
+    
+    stats.draw_calls += 1;
+    stats.triangles += sphere_index_count / 3 * count;
+}
+
+//------------------------------------------------------------
+// Name: DrawDebugLines
+// Desc: Streams the frame's debug lines into one buffer and
+//       draws them with a single call, ignoring depth
+//------------------------------------------------------------
+void CoreRenderer::DrawDebugLines(const debug_vertex *vertices, unsigned int count) {
+    if(count == 0)
+        return;
+    
+    COUNTED_STATE(glBindBuffer(GL_ARRAY_BUFFER, line_vertex_buffer));
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(debug_vertex), vertices, GL_STREAM_DRAW);
+    COUNTED_STATE(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    
+    COUNTED_STATE(glDisable(GL_DEPTH_TEST));
+    COUNTED_STATE(glUseProgram(line_program));
+    
+    COUNTED_STATE(glBindVertexArray(line_vertex_array));
+    glDrawArrays(GL_LINES, 0, count);
+    COUNTED_STATE(glBindVertexArray(0));
+    
+    COUNTED_STATE(glEnable(GL_DEPTH_TEST));
+    
+    stats.draw_calls += 1;
+}
+
+CoreRenderer::~CoreRenderer() {
+    for(std::map<StaticMesh *, core_static_mesh>::iterator it = meshes.begin(); it != meshes.end(); ++it) {
+        glDeleteVertexArrays(1, &it->second.vertex_array);
+        glDeleteBuffers(1, &it->second.vertex_buffer);
+        glDeleteBuffers(1, &it->second.material_buffer);
+    }
+    
+    glDeleteVertexArrays(1, &sphere_vertex_array);
+    glDeleteBuffers(1, &sphere_vertex_buffer);
+    glDeleteBuffers(1, &sphere_index_buffer);
+    glDeleteBuffers(1, &sphere_instance_buffer);
+    glDeleteVertexArrays(1, &skybox_vertex_array);
+    glDeleteVertexArrays(1, &line_vertex_array);
+    glDeleteBuffers(1, &line_vertex_buffer);
+    
+    glDeleteBuffers(1, &frame_buffer);
+    glDeleteBuffers(1, &sphere_material_buffer);
+    
+    glDeleteProgram(mesh_program);
+    glDeleteProgram(sphere_program);
+    glDeleteProgram(skybox_program);
+    glDeleteProgram(line_program);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <map>
+
+#include "renderer.h"
+
+typedef struct {
+    GLint first;
+    GLsizei count;
+    
+    unsigned int material_index;
+    GLuint gl_tex_id; // 0 if untextured
+} core_mesh_range;
+
+typedef struct {
+    GLuint vertex_array;
+    GLuint vertex_buffer;
+    GLuint material_buffer;
+    
+    std::vector<core_mesh_range> ranges;
+} core_static_mesh;
+
+class CoreRenderer : public Renderer {
+public:
+    CoreRenderer(int width, int height);
+    ~CoreRenderer();
+    
+    void Resize(int width, int height);
+    
+    void BeginFrame(const mat4& view);
+    
+    void DrawSkybox(Skybox *skybox);
+    void DrawStaticMesh(StaticMesh *mesh);
+    void ReleaseStaticMesh(StaticMesh *mesh);
+    void DrawSpheres(const sphere_instance *spheres, unsigned int count);
+    
+    void DrawDebugLines(const debug_vertex *vertices, unsigned int count);
+private:
+    core_static_mesh *UploadStaticMesh(StaticMesh *mesh);
+    
+    mat4 proj;
+    mat4 view;
+    
+    GLuint mesh_program;
+    GLuint sphere_program;
+    GLuint skybox_program;
+    GLuint line_program;
+    
+    // Uniform buffers: per-frame matrices, and the materials (one aligned slot each)
+    GLuint frame_buffer;
+    GLuint sphere_material_buffer;
+    GLint material_stride;
+    
+    // Unit sphere mesh, drawn instanced
+    GLuint sphere_vertex_array;
+    GLuint sphere_vertex_buffer;
+    GLuint sphere_index_buffer;
+    GLuint sphere_instance_buffer;
+    GLsizei sphere_index_count;
+    
+    GLuint skybox_vertex_array;
+    GLuint skybox_vertex_buffer; // Buffer the VAO was set up with
+    
+    // Debug lines, refilled every frame they are drawn
+    GLuint line_vertex_array;
+    GLuint line_vertex_buffer;
+    
+    std::map<StaticMesh *, core_static_mesh> meshes;
+};
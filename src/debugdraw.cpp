@@ -0,0 +1,67 @@
+#include "debugdraw.h"
+
+#ifdef DEBUG_DRAW
+
+// Nothing is gathered until a category is switched on
+unsigned int debug_draw_flags = 0;
+
+// Line list (two vertices per segment) for the current frame
+std::vector<debug_vertex> debug_draw_vertices;
+
+//----------------------------------------------------------------
+// Name: DebugDrawClear
+// Desc: Empties the line list, keeping its memory for next frame
+//----------------------------------------------------------------
+void DebugDrawClear() {
+    debug_draw_vertices.clear();
+}
+
+//----------------------------------------------------------------
+// Name: DebugDrawLine
+// Desc: Adds one line segment
+//----------------------------------------------------------------
+void DebugDrawLine(vec3 a, vec3 b, unsigned int color) {
+    debug_vertex v;
+    v.color = color;
+    
+    v.position = a;
+    debug_draw_vertices.push_back(v);
+    
+    v.position = b;
+    debug_draw_vertices.push_back(v);
+}
+
+//----------------------------------------------------------------
+// Name: DebugDrawTriangle
+// Desc: Adds the outline of a triangle
+//----------------------------------------------------------------
+void DebugDrawTriangle(vec3 A, vec3 B, vec3 C, unsigned int color) {
+    DebugDrawLine(A, B, color);
+    DebugDrawLine(B, C, color);
+    DebugDrawLine(C, A, color);
+}
+
+//----------------------------------------------------------------
+// Name: DebugDrawBox
+// Desc: Adds the twelve edges of an axis-aligned box
+//----------------------------------------------------------------
+void DebugDrawBox(vec3 bounds_min, vec3 bounds_max, unsigned int color) {
+    vec3 corners[8];
+    
+    for(int i = 0; i < 8; i++) {
+        corners[i] = vec3(
+            i & 1 ? bounds_max.x : bounds_min.x,
+            i & 2 ? bounds_max.y : bounds_min.y,
+            i & 4 ? bounds_max.z : bounds_min.z);
+    }
+    
+    // Each corner connects to the corners differing in exactly one axis bit
+    for(int i = 0; i < 8; i++) {
+        for(int axis = 1; axis < 8; axis <<= 1) {
+            if(!(i & axis))
+                DebugDrawLine(corners[i], corners[i | axis], color);
+        }
+    }
+}
+
+#endif
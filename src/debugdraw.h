@@ -0,0 +1,51 @@
+#pragma once
+
+#include "common.h"
+
+// What the collision pipeline draws, toggled at runtime through debug_draw_flags
+#define DEBUG_DRAW_CANDIDATES 0x1 // Triangles returned by the broadphase
+#define DEBUG_DRAW_CONTACTS   0x2 // Triangles hit, and the contact normals
+#define DEBUG_DRAW_BVH        0x4 // BVH nodes overlapped by sphere queries
+
+// Line colours, packed as RGBA bytes (0xAABBGGRR)
+#define DEBUG_COLOR_CANDIDATE 0xFF00FFFFu
+#define DEBUG_COLOR_HIT       0xFF0000FFu
+#define DEBUG_COLOR_NORMAL    0xFF00FF00u
+#define DEBUG_COLOR_BVH_INNER 0xFF804000u
+#define DEBUG_COLOR_BVH_LEAF  0xFFFFFF00u
+
+typedef struct {
+    vec3 position;
+    unsigned int color;
+} debug_vertex;
+
+//------------------------------------------------------------------------
+// Debug drawing gathers line segments from anywhere in the simulation into
+// one vertex list per frame, which the renderer draws with a single call.
+// It only exists in builds with DEBUG_DRAW defined; otherwise the macros
+// below expand to nothing and their arguments are never evaluated
+//------------------------------------------------------------------------
+#ifdef DEBUG_DRAW
+
+extern unsigned int debug_draw_flags;
+extern std::vector<debug_vertex> debug_draw_vertices;
+
+void DebugDrawClear();
+void DebugDrawLine(vec3 a, vec3 b, unsigned int color);
+void DebugDrawTriangle(vec3 A, vec3 B, vec3 C, unsigned int color);
+void DebugDrawBox(vec3 bounds_min, vec3 bounds_max, unsigned int color);
+
+#define DEBUG_DRAW_LINE(category, a, b, color) \
+    do { if(debug_draw_flags & (category)) DebugDrawLine(a, b, color); } while(0)
+#define DEBUG_DRAW_TRIANGLE(category, A, B, C, color) \
+    do { if(debug_draw_flags & (category)) DebugDrawTriangle(A, B, C, color); } while(0)
+#define DEBUG_DRAW_BOX(category, bounds_min, bounds_max, color) \
+    do { if(debug_draw_flags & (category)) DebugDrawBox(bounds_min, bounds_max, color); } while(0)
+
+#else
+
+#define DEBUG_DRAW_LINE(category, a, b, color) ((void)0)
+#define DEBUG_DRAW_TRIANGLE(category, A, B, C, color) ((void)0)
+#define DEBUG_DRAW_BOX(category, bounds_min, bounds_max, color) ((void)0)
+
+#endif
@@ -0,0 +1,137 @@
+#include "dxt.h"
+
+static inline unsigned short PackRGB565(int r, int g, int b) {
+    return (unsigned short)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static inline void UnpackRGB565(unsigned short c, int *rgb) {
+    rgb[0] = ((c >> 11) & 31) * 255 / 31;
+    rgb[1] = ((c >> 5) & 63) * 255 / 63;
+    rgb[2] = (c & 31) * 255 / 31;
+}
+
+//------------------------------------------------------------------------------------
+// Name: CompressDXT1Block
+// Desc: Encodes one 4x4 block of RGB pixels. The two endpoints are the corners of
+//       the block's colour bounding box, inset slightly to reduce the error from
+//       outliers; each pixel then takes the nearest of the four palette colours
+//------------------------------------------------------------------------------------
+static void CompressDXT1Block(const unsigned char rgb[16][3], unsigned char *out) {
+    int lo[3] = { 255, 255, 255 };
+    int hi[3] = { 0, 0, 0 };
+    
+    for(int i = 0; i < 16; i++) {
+        for(int k = 0; k < 3; k++) {
+            if(rgb[i][k] < lo[k]) lo[k] = rgb[i][k];
+            if(rgb[i][k] > hi[k]) hi[k] = rgb[i][k];
+        }
+    }
+    
+    for(int k = 0; k < 3; k++) {
+        int inset = (hi[k] - lo[k]) / 16;
+        lo[k] += inset;
+        hi[k] -= inset;
+    }
+    
+    unsigned short c0 = PackRGB565(hi[0], hi[1], hi[2]);
+    unsigned short c1 = PackRGB565(lo[0], lo[1], lo[2]);
+    
+    // c0 > c1 selects the four-colour mode
+    if(c0 < c1) {
+        unsigned short t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+    
+    int palette[4][3];
+    UnpackRGB565(c0, palette[0]);
+    UnpackRGB565(c1, palette[1]);
+    
+    for(int k = 0; k < 3; k++) {
+        palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+        palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+    }
+    
+    unsigned int indices = 0;
+    
+    if(c0 != c1) {
+        for(int i = 0; i < 16; i++) {
+            int best = 0;
+            int best_error = 0x7FFFFFFF;
+            
+            for(int p = 0; p < 4; p++) {
+                int dr = rgb[i][0] - palette[p][0];
+                int dg = rgb[i][1] - palette[p][1];
+                int db = rgb[i][2] - palette[p][2];
+                int error = dr * dr + dg * dg + db * db;
+                
+                if(error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            
+            indices |= (unsigned int)best << (i * 2);
+        }
+    }
+    
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    out[4] = indices & 0xFF;
+    out[5] = (indices >> 8) & 0xFF;
+    out[6] = (indices >> 16) & 0xFF;
+    out[7] = indices >> 24;
+}
+
+//------------------------------------------------------------------------------------
+// Name: CompressDXT1
+// Desc: Compresses a tightly packed BGR image to DXT1. Blocks hanging over the
+//       edge of images smaller than 4x4 repeat their last row/column
+//------------------------------------------------------------------------------------
+void CompressDXT1(const unsigned char *bgr, unsigned int width, unsigned int height, unsigned char *out) {
+    for(unsigned int by = 0; by < height; by += 4) {
+        for(unsigned int bx = 0; bx < width; bx += 4) {
+            unsigned char block[16][3];
+            
+            for(unsigned int y = 0; y < 4; y++) {
+                for(unsigned int x = 0; x < 4; x++) {
+                    unsigned int px = bx + x < width ? bx + x : width - 1;
+                    unsigned int py = by + y < height ? by + y : height - 1;
+                    const unsigned char *src = bgr + (py * width + px) * 3;
+                    
+                    block[y * 4 + x][0] = src[2];
+                    block[y * 4 + x][1] = src[1];
+                    block[y * 4 + x][2] = src[0];
+                }
+            }
+            
+            CompressDXT1Block(block, out);
+            out += 8;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Name: DownsampleBGR
+// Desc: Box-filters a BGR image to half size for the next mipmap level
+//------------------------------------------------------------------------------------
+void DownsampleBGR(const unsigned char *bgr, unsigned int width, unsigned int height, unsigned char *out) {
+    unsigned int out_width = width > 1 ? width / 2 : 1;
+    unsigned int out_height = height > 1 ? height / 2 : 1;
+    
+    for(unsigned int y = 0; y < out_height; y++) {
+        for(unsigned int x = 0; x < out_width; x++) {
+            unsigned int x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : x * 2;
+            unsigned int y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : y * 2;
+            
+            for(int k = 0; k < 3; k++) {
+                unsigned int sum = bgr[(y0 * width + x0) * 3 + k] + bgr[(y0 * width + x1) * 3 + k] +
+                                   bgr[(y1 * width + x0) * 3 + k] + bgr[(y1 * width + x1) * 3 + k];
+                
+                out[(y * out_width + x) * 3 + k] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
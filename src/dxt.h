@@ -0,0 +1,9 @@
+#pragma once
+
+// Size in bytes of a DXT1 (BC1) image, 8 bytes per 4x4 block
+inline unsigned int DXT1Size(unsigned int width, unsigned int height) {
+    return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+void CompressDXT1(const unsigned char *bgr, unsigned int width, unsigned int height, unsigned char *out);
+void DownsampleBGR(const unsigned char *bgr, unsigned int width, unsigned int height, unsigned char *out);
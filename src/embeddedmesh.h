@@ -0,0 +1,27 @@
+#pragma once
+
+//------------------------------------------------------------------------
+// Collision meshes compiled into the binary. tools/obj2cpp cooks an OBJ
+// file at build time into a header of constexpr arrays: the triangles in
+// BVH order and the BVH nodes themselves, so the mesh needs neither file
+// I/O nor a BVH build at run time. CollisionMesh(const embedded_mesh&)
+// turns one into a regular CollisionMesh
+//------------------------------------------------------------------------
+typedef struct {
+    float bounds_min[3];
+    float bounds_max[3];
+    
+    unsigned int first;
+    unsigned int count;
+} embedded_bvh_node;
+
+typedef struct {
+    const float *triangles; // Nine floats per triangle
+    unsigned int num_triangles;
+    
+    const embedded_bvh_node *nodes;
+    unsigned int num_nodes;
+    
+    float bounds_min[3];
+    float bounds_max[3];
+} embedded_mesh;
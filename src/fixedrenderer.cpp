@@ -0,0 +1,182 @@
+#include "fixedrenderer.h"
+
+// Tessellation of the GLU spheres
+#define SPHERE_SLICES 20
+#define SPHERE_STACKS 20
+
+// Light properties
+static GLfloat light_ambient[] = {1.0, 1.0, 1.0, 1.0};
+static GLfloat light_diffuse[] = {1.0, 1.0, 1.0, 1.0};
+static GLfloat light_position[] = {1.0, 1.0, 1.0, 0.0};
+
+// Global material properties
+static GLfloat mat_shininess[] = {8.0};
+
+// Sphere material properties (the diffuse colour comes from each instance)
+static GLfloat mat_sphere_ambient[] = {0.0, 0.1, 0.2, 1.0};
+static GLfloat mat_sphere_specular[] = {1.0, 1.0, 1.0, 1.0};
+
+//------------------------------------------------------------
+// Name: FixedRenderer
+// Desc: Constructor for the FixedRenderer class.
+//       Sets up the fixed-function lighting and render state
+//------------------------------------------------------------
+FixedRenderer::FixedRenderer(int width, int height) {
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    
+    glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
+    glLightfv(GL_LIGHT0, GL_POSITION, light_position);
+    
+    glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+    
+    glEnable(GL_MULTISAMPLE);
+    
+    glEnable(GL_LIGHT0);
+    glEnable(GL_LIGHTING);
+    
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    
+    Resize(width, height);
+    
+    // Setup GLU sphere quadratic for drawing later
+    sphereQuadratic = gluNewQuadric();
+    gluQuadricNormals(sphereQuadratic, GLU_SMOOTH);
+}
+
+//------------------------------------------------------------
+// Name: Resize
+// Desc: Updates the viewport and projection matrix
+//------------------------------------------------------------
+void FixedRenderer::Resize(int width, int height) {
+    glViewport(0, 0, width, height);
+    
+    glMatrixMode(GL_PROJECTION);
+    proj = perspective(45.0f, (float)width/height, 0.1f, 1000.0f);
+    glLoadMatrixf(&proj[0][0]);
+    
+    glMatrixMode(GL_MODELVIEW);
+}
+
+//------------------------------------------------------------
+// Name: BeginFrame
+// Desc: Clears the frame and resets the frame's stats
+//------------------------------------------------------------
+void FixedRenderer::BeginFrame(const mat4& frame_view) {
+    view = frame_view;
+    
+    memset(&stats, 0, sizeof(stats));
+    
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+//------------------------------------------------------------
+// Name: DrawSkybox
+// Desc: Draws the skybox with only the view rotation applied
+//------------------------------------------------------------
+void FixedRenderer::DrawSkybox(Skybox *skybox) {
+    // Extract the view rotation into the skybox model matrix
+    mat4 skybox_model = mat4(1.0f);
+    skybox_model[0] = vec4(view[0][0], view[0][1], view[0][2], 0.0f);
+    skybox_model[1] = vec4(view[1][0], view[1][1], view[1][2], 0.0f);
+    skybox_model[2] = vec4(view[2][0], view[2][1], view[2][2], 0.0f);
+    
+    COUNTED_STATE(glLoadMatrixf(&skybox_model[0][0]));
+    
+    // The skybox sets up its own cubemap, counted as one change
+    skybox->Draw();
+    
+    stats.draw_calls += 1;
+    stats.state_changes += 1;
+    stats.triangles += skybox->GetVertexCount() / 3;
+}
+
+//------------------------------------------------------------
+// Name: DrawStaticMesh
+// Desc: Draws a static mesh at the world origin
+//------------------------------------------------------------
+void FixedRenderer::DrawStaticMesh(StaticMesh *mesh) {
+    COUNTED_STATE(glLoadMatrixf(&view[0][0]));
+    
+    mesh->Draw();
+    
+    // StaticMesh::Draw sets up each submesh's material, and wraps every face
+    // in its own glBegin/glEnd
+    for(unsigned int i = 0; i < mesh->groups.size(); i++) {
+        for(unsigned int j = 0; j < mesh->groups[i].submeshes.size(); j++) {
+            stats.state_changes += 1;
+            stats.draw_calls += mesh->groups[i].submeshes[j].num_faces;
+            stats.triangles += mesh->groups[i].submeshes[j].num_faces;
+        }
+    }
+}
+
+//------------------------------------------------------------
+// Name: ReleaseStaticMesh
+// Desc: Nothing to do, meshes are drawn straight from the CPU
+//------------------------------------------------------------
+void FixedRenderer::ReleaseStaticMesh(StaticMesh *mesh) {
+}
+
+//------------------------------------------------------------
+// Name: DrawSpheres
+// Desc: Draws each sphere with its own GLU call
+//------------------------------------------------------------
+void FixedRenderer::DrawSpheres(const sphere_instance *spheres, unsigned int count) {
+    COUNTED_STATE(glMaterialfv(GL_FRONT, GL_AMBIENT, mat_sphere_ambient));
+    COUNTED_STATE(glMaterialfv(GL_FRONT, GL_SPECULAR, mat_sphere_specular));
+    
+    for(unsigned int i = 0; i < count; i++) {
+        mat4 sphere_composite = translate(view, spheres[i].position);
+        COUNTED_STATE(glLoadMatrixf(&sphere_composite[0][0]));
+        
+        COUNTED_STATE(glMaterialfv(GL_FRONT, GL_DIFFUSE, &spheres[i].color[0]));
+        
+        gluSphere(sphereQuadratic, spheres[i].radius, SPHERE_SLICES, SPHERE_STACKS);
+    }
+    
+    // gluSphere draws one fan or strip per stack
+    stats.draw_calls += count * SPHERE_STACKS;
+    stats.triangles += count * SPHERE_SLICES * (SPHERE_STACKS - 1) * 2;
+}
+
+//------------------------------------------------------------
+// Name: DrawDebugLines
+// Desc: Draws the frame's debug lines straight from client
+//       memory with a single call, unlit and ignoring depth
+//------------------------------------------------------------
+void FixedRenderer::DrawDebugLines(const debug_vertex *vertices, unsigned int count) {
+    if(count == 0)
+        return;
+    
+    COUNTED_STATE(glLoadMatrixf(&view[0][0]));
+    
+    COUNTED_STATE(glDisable(GL_LIGHTING));
+    COUNTED_STATE(glDisable(GL_DEPTH_TEST));
+    
+    COUNTED_STATE(glEnableClientState(GL_VERTEX_ARRAY));
+    COUNTED_STATE(glEnableClientState(GL_COLOR_ARRAY));
+    
+    COUNTED_STATE(glVertexPointer(3, GL_FLOAT, sizeof(debug_vertex), &vertices[0].position));
+    COUNTED_STATE(glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(debug_vertex), &vertices[0].color));
+    
+    glDrawArrays(GL_LINES, 0, count);
+    
+    COUNTED_STATE(glDisableClientState(GL_COLOR_ARRAY));
+    COUNTED_STATE(glDisableClientState(GL_VERTEX_ARRAY));
+    
+    COUNTED_STATE(glEnable(GL_DEPTH_TEST));
+    COUNTED_STATE(glEnable(GL_LIGHTING));
+    
+    stats.draw_calls += 1;
+}
+
+FixedRenderer::~FixedRenderer() {
+    gluDeleteQuadric(sphereQuadratic);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "renderer.h"
+
+class FixedRenderer : public Renderer {
+public:
+    FixedRenderer(int width, int height);
+    ~FixedRenderer();
+    
+    void Resize(int width, int height);
+    
+    void BeginFrame(const mat4& view);
+    
+    void DrawSkybox(Skybox *skybox);
+    void DrawStaticMesh(StaticMesh *mesh);
+    void ReleaseStaticMesh(StaticMesh *mesh);
+    void DrawSpheres(const sphere_instance *spheres, unsigned int count);
+    
+    void DrawDebugLines(const debug_vertex *vertices, unsigned int count);
+private:
+    mat4 proj;
+    mat4 view;
+    
+    // For GLU sphere drawing
+    GLUquadric *sphereQuadratic;
+};
@@ -0,0 +1,145 @@
+#include "game.h"
+
+static const vec3 player_spawn_pos(0, 5, 5);
+
+//------------------------------------------------------------
+// Name: Game
+// Desc: Constructor for the Game class. Sets up the player and
+//       the loose balls in their starting positions
+//------------------------------------------------------------
+Game::Game(const CollisionMesh *terrain) : terrain(terrain), terrain_chunks(nullptr) {
+    // Initialize transforms
+    player_pos = player_spawn_pos;
+    player_collide_radius = 1.0f;
+    
+    camera_orbit_rotation = vec3(0, 0, 0);
+    camera_probe_radius = 0.3f;
+    
+    // Setup the physics world, with the player and a few loose balls to push around
+    player_body = world.AddBody(player_pos, player_collide_radius, 1.0f);
+    
+    for(int i = 0; i < 8; i++)
+        world.AddBody(vec3(-6.0f + i * 1.5f, 8.0f + i, 0.0f), 0.5f + (i % 3) * 0.25f, 0.5f);
+    
+    frame = 0;
+    
+    UpdateCamera();
+}
+
+//------------------------------------------------------------
+// Name: Game
+// Desc: Constructor for the Game class, on a terrain streamed in
+//       chunks. The caller keeps the chunks around the player
+//       loaded with ChunkedTerrain::Update between steps
+//------------------------------------------------------------
+Game::Game(const ChunkedTerrain *terrain_chunks) : Game((const CollisionMesh *)nullptr) {
+    this->terrain_chunks = terrain_chunks;
+    
+    UpdateCamera();
+}
+
+//------------------------------------------------------------
+// Name: Step
+// Desc: Advances the game by one frame using the given input
+//------------------------------------------------------------
+void Game::Step(const game_input& input) {
+    // Spawn back at start
+    if(input.buttons & INPUT_RESPAWN)
+        world.ResetBody(player_body, player_spawn_pos);
+    
+    // Basic player movement
+    vec3 player_move(0, 0, 0);
+    
+    if(input.buttons & INPUT_FORWARD)
+        player_move -= normalize(vec3(view_forward.x, 0, view_forward.z)) * 0.2f;
+    else if(input.buttons & INPUT_BACK)
+        player_move += normalize(vec3(view_forward.x, 0, view_forward.z)) * 0.2f;
+    
+    if(input.buttons & INPUT_LEFT)
+        player_move -= normalize(vec3(view_right.x, 0, view_right.z)) * 0.2f;
+    else if(input.buttons & INPUT_RIGHT)
+        player_move += normalize(vec3(view_right.x, 0, view_right.z)) * 0.2f;
+    
+    // Jump
+    if(input.buttons & INPUT_JUMP)
+        player_move.y += 0.35f;
+    
+    world.MoveBody(player_body, player_move);
+    
+    // Rotate the camera around the player using the mouse
+    camera_orbit_rotation.x += input.mouse_dy * 0.5f;
+    camera_orbit_rotation.y += input.mouse_dx * 0.5f;
+    
+    // Apply gravity and resolve collisions between bodies and against the terrain
+    if(terrain_chunks != nullptr)
+        world.Step(terrain_chunks);
+    else
+        world.Step(terrain);
+    
+    player_pos = world.GetPosition(player_body);
+    
+    UpdateCamera();
+    
+    frame++;
+}
+
+//------------------------------------------------------------
+// Name: UpdateCamera
+// Desc: Builds the view matrix, in which the camera follows an
+//       orbital point from a distance
+//------------------------------------------------------------
+void Game::UpdateCamera() {
+    camera_orbit_model = rotate(mat4(1.0f), radians(camera_orbit_rotation.x), vec3(1, 0, 0));
+    camera_orbit_model = rotate(camera_orbit_model, radians(camera_orbit_rotation.y), vec3(0, 1, 0));
+    camera_orbit_model = rotate(camera_orbit_model, radians(camera_orbit_rotation.z), vec3(0, 0, 1));
+    
+    // Pull the camera in towards the player if the terrain gets in the way
+    vec3 camera_dir = normalize(vec3(inverse(camera_orbit_model) * vec4(0, 0, 1, 0)));
+    float camera_distance = 10.0f;
+    
+    RayHit camera_hit;
+    
+    bool is_blocked = terrain_chunks != nullptr ?
+        terrain_chunks->SphereCast(camera_hit, player_pos, camera_dir, camera_probe_radius, camera_distance) :
+        terrain != nullptr && terrain->SphereCast(camera_hit, player_pos, camera_dir, camera_probe_radius, camera_distance);
+    
+    if(is_blocked)
+        camera_distance = camera_hit.t;
+    
+    camera_orbit_model = translate(camera_orbit_model, -player_pos);
+    
+    mat4 camera = translate(mat4(1.0f), vec3(0, 0, -camera_distance));
+    
+    view = camera * camera_orbit_model;
+    
+    // Update the view orientation vectors
+    mat4 view_inverse = inverse(view);
+    view_right   = normalize(vec3(view_inverse[0]));
+    view_up      = normalize(vec3(view_inverse[1]));
+    view_forward = normalize(vec3(view_inverse[2]));
+    
+    // Build the player model matrix
+    player_model = translate(mat4(1.0f), player_pos);
+}
+
+//------------------------------------------------------------
+// Name: StateHash
+// Desc: FNV-1a hash over the exact bits of every body position,
+//       used to detect any divergence during replay
+//------------------------------------------------------------
+unsigned int Game::StateHash() const {
+    unsigned int hash = 2166136261u;
+    
+    const std::vector<float> *fields[3] = { &world.pos_x, &world.pos_y, &world.pos_z };
+    
+    for(int f = 0; f < 3; f++) {
+        const unsigned char *bytes = (const unsigned char *)fields[f]->data();
+        
+        for(size_t i = 0; i < fields[f]->size() * sizeof(float); i++) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    }
+    
+    return hash;
+}
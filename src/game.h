@@ -0,0 +1,61 @@
+#pragma once
+
+#include "common.h"
+#include "chunkedterrain.h"
+#include "collisionmesh.h"
+#include "physicsworld.h"
+
+// Buttons held during a frame
+#define INPUT_FORWARD  (1 << 0)
+#define INPUT_BACK     (1 << 1)
+#define INPUT_LEFT     (1 << 2)
+#define INPUT_RIGHT    (1 << 3)
+#define INPUT_JUMP     (1 << 4)
+#define INPUT_RESPAWN  (1 << 5)
+
+typedef struct {
+    unsigned char buttons;
+    
+    float mouse_dx;
+    float mouse_dy;
+} game_input;
+
+//------------------------------------------------------------------------
+// The simulated part of the demo. Everything here depends only on the
+// terrain and the sequence of inputs, and nothing here touches GLFW or
+// OpenGL, so a session can be replayed headlessly and deterministically
+//------------------------------------------------------------------------
+class Game {
+public:
+    Game(const CollisionMesh *terrain);
+    Game(const ChunkedTerrain *terrain_chunks);
+    
+    void Step(const game_input& input);
+    
+    unsigned int StateHash() const;
+    
+    // The terrain, either one mesh or streamed in chunks (the other is null)
+    const CollisionMesh *terrain;
+    const ChunkedTerrain *terrain_chunks;
+    
+    // Dynamic bodies (the player is one of them)
+    PhysicsWorld world;
+    unsigned int player_body;
+    
+    // Transforms
+    vec3  player_pos;
+    float player_collide_radius;
+    
+    vec3  camera_orbit_rotation;
+    float camera_probe_radius;
+    
+    // Matrices
+    mat4 view;
+    vec3 view_right, view_up, view_forward;
+    
+    mat4 camera_orbit_model, player_model;
+    
+    unsigned int frame;
+private:
+    void UpdateCamera();
+};
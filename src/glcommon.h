@@ -0,0 +1,5 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "common.h"
@@ -1,4 +1,10 @@
-#include "collision.h"
+#include "chunkedterrain.h"
+#include "collisionmesh.h"
+#include "corerenderer.h"
+#include "debugdraw.h"
+#include "fixedrenderer.h"
+#include "game.h"
+#include "replay.h"
 #include "skybox.h"
 #include "staticmesh.h"
 
@@ -7,41 +13,50 @@
 #define WINDOW_WIDTH 1280
 #define WINDOW_HEIGHT 720
 
+// Terrain streaming (--chunks <directory cooked by chunkcook>)
+#define CHUNK_LOAD_RADIUS 12.0f
+#define CHUNK_MEMORY_BUDGET (512 * 1024)
+
 // GLFW
 GLFWwindow *window;
 
 // Scene objects
 Skybox *SceneSkybox;
 StaticMesh *TerrainMesh;
+CollisionMesh *TerrainCollision;
 
-// Transforms
-vec3  player_pos;
-float player_collide_radius;
-float player_gravity;
+// Streamed terrain, used instead of the two above with --chunks
+ChunkedTerrain *TerrainChunks;
+StaticMesh *ChunkMaterials;
+const char *chunk_directory;
+std::vector<vec3> chunk_focus;
 
-vec3  camera_orbit_rotation;
+// Simulation state (player, bodies and camera)
+Game *SceneGame;
 
-// Matrices
-mat4 proj, view;
-vec3 view_right, view_up, view_forward;
+// Optional session recording (--record <file>)
+ReplayRecorder *Recorder;
 
-mat4 camera_orbit_model, player_model;
+// Rendering backend (--renderer fixed|core)
+Renderer *SceneRenderer;
+bool use_core_renderer;
 
-// For GLU sphere drawing
-GLUquadric* sphereQuadratic;
+// Swap interval (--no-vsync to render as fast as possible)
+bool use_vsync;
 
-// Light properties
-GLfloat light_ambient[] = {1.0, 1.0, 1.0, 1.0};
-GLfloat light_diffuse[] = {1.0, 1.0, 1.0, 1.0};
-GLfloat light_position[] = {1.0, 1.0, 1.0, 0.0};
+// Sphere colours
+vec4 player_color(1.0, 1.0, 0.0, 1.0);
+vec4 body_color(0.2, 0.6, 1.0, 1.0);
 
-// Global material properties
-GLfloat mat_shininess[] = {8.0};
+// Per-frame sphere instances handed to the renderer
+std::vector<sphere_instance> sphere_instances;
 
-// Object-specific material properties
-GLfloat mat_player_diffuse[] = {1.0, 1.0, 0.0, 1.0};
-GLfloat mat_player_ambient[] = {0.0, 0.1, 0.2, 1.0};
-GLfloat mat_player_specular[] = {1.0, 1.0, 1.0, 1.0};
+#ifdef DEBUG_DRAW
+// F1-F3 toggle the debug draw categories
+const int debug_draw_keys[3] = { GLFW_KEY_F1, GLFW_KEY_F2, GLFW_KEY_F3 };
+const unsigned int debug_draw_categories[3] = { DEBUG_DRAW_CANDIDATES, DEBUG_DRAW_CONTACTS, DEBUG_DRAW_BVH };
+bool debug_draw_keys_down[3];
+#endif
 
 // For mouse movement
 vec2 mouse_pos(0, 0);
@@ -49,49 +64,74 @@ vec2 mouse_last_pos(0, 0);
 vec2 mouse_delta_pos(0, 0);
 
 //------------------------------------------------------------
-// Name: demo_init
-// Desc: Perform global setup of the program
+// Name: chunk_render_load
+// Desc: Parses a chunk's render mesh on the streaming thread.
+//       Nothing touches GL until the renderer first draws it
 //------------------------------------------------------------
-static void demo_init() {
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glClearColor(0.0, 0.0, 0.0, 1.0);
-    
-    glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
-    glLightfv(GL_LIGHT0, GL_POSITION, light_position);
-    
-    glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
-    
-    glEnable(GL_MULTISAMPLE);
+static void *chunk_render_load(const char *directory, const char *filename, void *user) {
+    return new StaticMesh(directory, filename, ChunkMaterials);
+}
+
+//------------------------------------------------------------
+// Name: chunk_render_free
+// Desc: Frees an evicted chunk's render mesh and its GL buffers
+//------------------------------------------------------------
+static void chunk_render_free(void *render_data, void *user) {
+    StaticMesh *mesh = (StaticMesh *)render_data;
     
-    glEnable(GL_LIGHT0);
-    glEnable(GL_LIGHTING);
+    SceneRenderer->ReleaseStaticMesh(mesh);
+    delete mesh;
+}
+
+//------------------------------------------------------------
+// Name: update_chunks
+// Desc: Streams the terrain around every body, the player included
+//------------------------------------------------------------
+static void update_chunks() {
+    const PhysicsWorld &world = SceneGame->world;
     
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
+    chunk_focus.resize(world.NumBodies());
     
-    // Setup the projection matrix
-    glMatrixMode(GL_PROJECTION);
-    proj = perspective(45.0f, (float)WINDOW_WIDTH/WINDOW_HEIGHT, 0.1f, 1000.0f);
-    glLoadMatrixf(&proj[0][0]);
+    for(unsigned int i = 0; i < world.NumBodies(); i++)
+        chunk_focus[i] = world.GetPosition(i);
     
-    glMatrixMode(GL_MODELVIEW);
+    TerrainChunks->Update(chunk_focus.data(), (unsigned int)chunk_focus.size());
+}
+
+//------------------------------------------------------------
+// Name: demo_init
+// Desc: Perform global setup of the program
+//------------------------------------------------------------
+static void demo_init() {
+    // Setup the renderer, which owns the GL state and projection matrix
+    if(use_core_renderer)
+        SceneRenderer = new CoreRenderer(WINDOW_WIDTH, WINDOW_HEIGHT);
+    else
+        SceneRenderer = new FixedRenderer(WINDOW_WIDTH, WINDOW_HEIGHT);
     
     // Setup our scene objects
-    SceneSkybox = new Skybox();
-    TerrainMesh = new StaticMesh("data/Playground/", "Playground.obj");
-    
-    // Initialize transforms
-    player_pos = vec3(0, 5, 5);
-    player_collide_radius = 1.0f;
-    player_gravity = 0.0f;
+    SceneSkybox = new Skybox("data/Skybox/");
     
-    camera_orbit_rotation = vec3(0, 0, 0);
-    
-    // Setup GLU sphere quadratic for drawing later
-    sphereQuadratic = gluNewQuadric();
-    gluQuadricNormals(sphereQuadratic, GLU_SMOOTH);
+    if(chunk_directory != nullptr) {
+        TerrainChunks = new ChunkedTerrain(chunk_directory, CHUNK_MEMORY_BUDGET, CHUNK_LOAD_RADIUS);
+        
+        // Materials (and their textures) are shared by every chunk, so load them once here,
+        // from the directory as the terrain completed it with a separator
+        ChunkMaterials = new StaticMesh(TerrainChunks->directory, "materials.obj");
+        
+        TerrainChunks->SetRenderLoader(chunk_render_load, chunk_render_free, nullptr);
+        
+        SceneGame = new Game(TerrainChunks);
+        
+        // Don't drop the bodies before the ground under them is there
+        update_chunks();
+        TerrainChunks->WaitForLoads();
+    } else {
+        TerrainMesh = new StaticMesh("data/Playground/", "Playground.obj");
+        TerrainCollision = new CollisionMesh("data/Playground/", "Playground.obj");
+        
+        SceneGame = new Game(TerrainCollision);
+    }
     
     // HACK: Set mouse pos once so we can calculate delta pos later
     double mouse_x, mouse_y;
@@ -104,13 +144,7 @@ static void demo_init() {
 // Desc: GLFW callback function to handle window resize event
 //------------------------------------------------------------------
 static void demo_resize(GLFWwindow *window, int width, int height) {
-    glViewport(0, 0, width, height);
-    
-    glMatrixMode(GL_PROJECTION);
-    proj = perspective(45.0f, (float)width/height, 0.1f, 1000.0f);
-    glLoadMatrixf(&proj[0][0]);
-    
-    glMatrixMode(GL_MODELVIEW);
+    SceneRenderer->Resize(width, height);
 }
 
 //------------------------------------------------------------
@@ -123,9 +157,18 @@ static bool window_init() {
         return false;
     }
     
-    // Use OpenGL 3.0 (Last GL version with fixed-function pipeline!)
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    if(use_core_renderer) {
+        // OpenGL 3.3 core profile for the shader-based renderer
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    }
+    else {
+        // Use OpenGL 3.0 (Last GL version with fixed-function pipeline!)
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    }
     
     // Enable anti-aliasing (4x MSAA)
     glfwWindowHint(GLFW_SAMPLES, 4);
@@ -138,18 +181,24 @@ static bool window_init() {
     }
     
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1); // Enable vsync
+    glfwSwapInterval(use_vsync ? 1 : 0);
     
     glfwSetWindowSizeCallback(window, demo_resize);
     
     // Hide and lock the mouse cursor for camera movement later
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     
+    // Needed for GLEW to find core-profile entry points
+    glewExperimental = GL_TRUE;
+    
     if(glewInit() != GLEW_OK) {
         printf("ERROR: Failed to initialize GLEW!\n");
         return false;
     }
     
+    // glewInit can leave a harmless GL_INVALID_ENUM behind on core profiles
+    glGetError();
+    
     return true;
 }
 
@@ -158,6 +207,33 @@ static bool window_init() {
 // Desc: Program entry point
 //------------------------------------------------------------------
 int main(int argc, char **argv) {
+    Recorder = nullptr;
+    TerrainMesh = nullptr;
+    TerrainCollision = nullptr;
+    TerrainChunks = nullptr;
+    ChunkMaterials = nullptr;
+    chunk_directory = nullptr;
+    use_core_renderer = false;
+    use_vsync = true;
+    
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--record") && i + 1 < argc)
+            Recorder = new ReplayRecorder(argv[++i], "data/Playground/", "Playground.obj");
+        else if(!strcmp(argv[i], "--renderer") && i + 1 < argc)
+            use_core_renderer = !strcmp(argv[++i], "core");
+        else if(!strcmp(argv[i], "--chunks") && i + 1 < argc)
+            chunk_directory = argv[++i];
+        else if(!strcmp(argv[i], "--no-vsync"))
+            use_vsync = false;
+    }
+    
+    // Replays are checked against the whole Playground, and what is streamed
+    // in by a given frame depends on timing
+    if(Recorder != nullptr && chunk_directory != nullptr) {
+        printf("--chunks is ignored while recording\n");
+        chunk_directory = nullptr;
+    }
+    
     if(!window_init())
         return -1;
     
@@ -179,118 +255,90 @@ int main(int argc, char **argv) {
         
         mouse_delta_pos = mouse_pos - mouse_last_pos;
         
-        // Spawn back at start
-        if(glfwGetKey(window, GLFW_KEY_R)) {
-            player_pos = vec3(0, 5, 5);
-            player_gravity = 0.0f;
-        }
+        // Gather this frame's input for the simulation
+        game_input input;
+        input.buttons = 0;
+        input.mouse_dx = mouse_delta_pos.x;
+        input.mouse_dy = mouse_delta_pos.y;
         
-        // Basic player movement
         if(glfwGetKey(window, GLFW_KEY_W))
-            player_pos -= normalize(vec3(view_forward.x, 0, view_forward.z)) * 0.2f;
-        else if(glfwGetKey(window, GLFW_KEY_S))
-            player_pos += normalize(vec3(view_forward.x, 0, view_forward.z)) * 0.2f;
-        
+            input.buttons |= INPUT_FORWARD;
+        if(glfwGetKey(window, GLFW_KEY_S))
+            input.buttons |= INPUT_BACK;
         if(glfwGetKey(window, GLFW_KEY_A))
-            player_pos -= normalize(vec3(view_right.x, 0, view_right.z)) * 0.2f;
-        else if(glfwGetKey(window, GLFW_KEY_D))
-            player_pos += normalize(vec3(view_right.x, 0, view_right.z)) * 0.2f;
-        
-        // Jump
+            input.buttons |= INPUT_LEFT;
+        if(glfwGetKey(window, GLFW_KEY_D))
+            input.buttons |= INPUT_RIGHT;
         if(glfwGetKey(window, GLFW_KEY_SPACE))
-            player_pos.y += 0.35f;
-        
-        // Rotate the camera around the player using the mouse
-        camera_orbit_rotation.x += mouse_delta_pos.y * 0.5f;
-        camera_orbit_rotation.y += mouse_delta_pos.x * 0.5f;
-        
-        // Apply lazy downwards gravity
-        player_pos.y += player_gravity;
-        player_gravity -= 0.01f;
+            input.buttons |= INPUT_JUMP;
+        if(glfwGetKey(window, GLFW_KEY_R))
+            input.buttons |= INPUT_RESPAWN;
         
-        // TODO: Maybe we could move this collision detection and response somewhere else?
-        CollisionPacket collisionPacket;
-        
-        for(unsigned int i = 0; i < TerrainMesh->groups.size(); i++) {
-            for(unsigned int j = 0; j < TerrainMesh->groups[i].submeshes.size(); j++) {
-                for(unsigned int k = 0; k < TerrainMesh->groups[i].submeshes[j].num_faces; k++) {
-                    // Call the collision test routine for each triangle
-                    bool result = IsIntersectingSphereTriangle(
-                        collisionPacket,
-                        TerrainMesh->vertices[TerrainMesh->groups[i].submeshes[j].vertex_indices[k*3]],
-                        TerrainMesh->vertices[TerrainMesh->groups[i].submeshes[j].vertex_indices[k*3+1]],
-                        TerrainMesh->vertices[TerrainMesh->groups[i].submeshes[j].vertex_indices[k*3+2]],
-                        player_pos,
-                        player_collide_radius
-                        );
-                    
-                    if(result) {
-                        // If colliding with floor or ramp, kill gravity
-                        if(collisionPacket.normal.y > 0.5f)
-                            player_gravity = 0;
-                        
-                        // Push collision sphere away from the intersected triangle(s)
-                        player_pos += collisionPacket.normal * (collisionPacket.distance + 1);
-                    }
-                }
-            }
+#ifdef DEBUG_DRAW
+        for(int i = 0; i < 3; i++) {
+            bool down = glfwGetKey(window, debug_draw_keys[i]) != 0;
+            
+            if(down && !debug_draw_keys_down[i])
+                debug_draw_flags ^= debug_draw_categories[i];
+            
+            debug_draw_keys_down[i] = down;
         }
         
-        // Build the view matrix, in which the camera follows an orbital point from a distance
-        camera_orbit_model = rotate(mat4(1.0f), radians(camera_orbit_rotation.x), vec3(1, 0, 0));
-        camera_orbit_model = rotate(camera_orbit_model, radians(camera_orbit_rotation.y), vec3(0, 1, 0));
-        camera_orbit_model = rotate(camera_orbit_model, radians(camera_orbit_rotation.z), vec3(0, 0, 1));
-        camera_orbit_model = translate(camera_orbit_model, -player_pos);
-        
-        mat4 camera = translate(mat4(1.0f), vec3(0, 0, -10));
+        // Gathered afresh by this frame's collision queries
+        DebugDrawClear();
+#endif
         
-        view = camera * camera_orbit_model;
+        if(TerrainChunks != nullptr)
+            update_chunks();
         
-        // Update the view orientation vectors
-        mat4 view_inverse = inverse(view);
-        view_right   = normalize(vec3(view_inverse[0]));
-        view_up      = normalize(vec3(view_inverse[1]));
-        view_forward = normalize(vec3(view_inverse[2]));
+        SceneGame->Step(input);
         
-        // Build the player model matrix
-        player_model = translate(mat4(1.0f), player_pos);
+        if(Recorder != nullptr)
+            Recorder->RecordFrame(input, *SceneGame);
         
-        mat4 player_composite = view * player_model;
+        // Gather the player and the other bodies as sphere instances
+        const PhysicsWorld &world = SceneGame->world;
         
-        // Extract the view rotation into the skybox model matrix
-        mat4 skybox_model = mat4(1.0f);
-        skybox_model[0] = vec4(view[0][0], view[0][1], view[0][2], 0.0f);
-        skybox_model[1] = vec4(view[1][0], view[1][1], view[1][2], 0.0f);
-        skybox_model[2] = vec4(view[2][0], view[2][1], view[2][2], 0.0f);
+        sphere_instances.resize(world.NumBodies());
         
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        // Draw the skybox
-        glLoadMatrixf(&skybox_model[0][0]);
-        
-        SceneSkybox->Draw();
-        
-        // Draw the player
-        glLoadMatrixf(&player_composite[0][0]);
+        for(unsigned int i = 0; i < world.NumBodies(); i++) {
+            sphere_instances[i].position = world.GetPosition(i);
+            sphere_instances[i].radius = world.radius[i];
+            sphere_instances[i].color = i == SceneGame->player_body ? player_color : body_color;
+        }
         
-        glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_player_diffuse);
-        glMaterialfv(GL_FRONT, GL_AMBIENT, mat_player_ambient);
-        glMaterialfv(GL_FRONT, GL_SPECULAR, mat_player_specular);
+        SceneRenderer->BeginFrame(SceneGame->view);
         
-        gluSphere(sphereQuadratic, player_collide_radius, 20, 20);
+        SceneRenderer->DrawSkybox(SceneSkybox);
+        SceneRenderer->DrawSpheres(sphere_instances.data(), (unsigned int)sphere_instances.size());
         
         // Draw the static terrain mesh (at the world origin)
-        glLoadMatrixf(&view[0][0]);
+        if(TerrainChunks != nullptr) {
+            for(unsigned int i = 0; i < TerrainChunks->resident.size(); i++) {
+                const terrain_chunk &chunk = TerrainChunks->chunks[TerrainChunks->resident[i]];
+                SceneRenderer->DrawStaticMesh((StaticMesh *)chunk.render_data);
+            }
+        } else {
+            SceneRenderer->DrawStaticMesh(TerrainMesh);
+        }
         
-        TerrainMesh->Draw();
+#ifdef DEBUG_DRAW
+        SceneRenderer->DrawDebugLines(debug_draw_vertices.data(), (unsigned int)debug_draw_vertices.size());
+#endif
         
         // Frame finished
         fflush(stdout);
         glfwSwapBuffers(window);
     }
     
+    delete Recorder;
+    delete SceneGame;
+    delete TerrainChunks;
+    delete ChunkMaterials;
+    delete TerrainCollision;
     delete TerrainMesh;
     delete SceneSkybox;
+    delete SceneRenderer;
     
     // Cleanup GLFW
     glfwDestroyWindow(window);
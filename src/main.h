@@ -1,28 +1,7 @@
 #pragma once
 
 #include <iostream>
-#include <vector>
 
-#include <GL/glew.h>
-#include <GLFW/glfw3.h>
-
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-using glm::vec2;
-using glm::vec3;
-using glm::vec4;
-using glm::mat4;
-
-using glm::radians;
+#include "glcommon.h"
 
-using glm::dot;
-using glm::cross;
-using glm::inverse;
-
-using glm::translate;
-using glm::rotate;
-using glm::scale;
-
-using glm::perspective;
+#include <GLFW/glfw3.h>
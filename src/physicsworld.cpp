@@ -0,0 +1,463 @@
+#include "physicsworld.h"
+#include "debugdraw.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// Starting room for one body's terrain candidates each step
+#define PHYSICS_CANDIDATES_RESERVE 64
+
+// Starting room for the terrain chunks one body overlaps
+#define PHYSICS_CHUNKS_RESERVE 4
+
+// How far a body can move before its cached terrain leaves must be gathered again
+#define PHYSICS_TERRAIN_CACHE_MARGIN 0.5f
+
+//------------------------------------------------------------------------------------
+// Name: PhysicsWorld
+// Desc: Constructor for the PhysicsWorld class
+//------------------------------------------------------------------------------------
+PhysicsWorld::PhysicsWorld() {
+    gravity = 0.01f;
+    
+    num_broadphase_pairs = 0;
+    num_body_contacts = 0;
+    num_terrain_contacts = 0;
+    num_terrain_queries = 0;
+    num_terrain_cache_hits = 0;
+}
+
+//------------------------------------------------------------------------------------
+// Name: AddBody
+// Desc: Adds a sphere body to the pool and returns its index.
+//       A mass of zero makes the body immovable by other bodies
+//------------------------------------------------------------------------------------
+unsigned int PhysicsWorld::AddBody(vec3 position, float body_radius, float mass) {
+    unsigned int body = NumBodies();
+    
+    pos_x.push_back(position.x);
+    pos_y.push_back(position.y);
+    pos_z.push_back(position.z);
+    
+    vel_x.push_back(0.0f);
+    vel_y.push_back(0.0f);
+    vel_z.push_back(0.0f);
+    
+    radius.push_back(body_radius);
+    inv_mass.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+    
+    sweep_min.push_back(0.0f);
+    sweep_max.push_back(0.0f);
+    sweep_order.push_back(body);
+    
+    // Empty box, so the first step gathers the body's leaves
+    terrain_query_cache cache = { nullptr, 0, vec3(FLT_MAX), vec3(-FLT_MAX), 0, 0 };
+    terrain_cache.push_back(cache);
+    
+    return body;
+}
+
+//------------------------------------------------------------------------------------
+// Name: ResetBody
+// Desc: Teleports a body and clears its velocity
+//------------------------------------------------------------------------------------
+void PhysicsWorld::ResetBody(unsigned int body, vec3 position) {
+    pos_x[body] = position.x;
+    pos_y[body] = position.y;
+    pos_z[body] = position.z;
+    
+    vel_x[body] = 0.0f;
+    vel_y[body] = 0.0f;
+    vel_z[body] = 0.0f;
+}
+
+//------------------------------------------------------------------------------------
+// Name: MoveBody
+// Desc: Directly displaces a body, e.g. from player input
+//------------------------------------------------------------------------------------
+void PhysicsWorld::MoveBody(unsigned int body, vec3 delta) {
+    pos_x[body] += delta.x;
+    pos_y[body] += delta.y;
+    pos_z[body] += delta.z;
+}
+
+vec3 PhysicsWorld::GetPosition(unsigned int body) const {
+    return vec3(pos_x[body], pos_y[body], pos_z[body]);
+}
+
+//------------------------------------------------------------------------------------
+// Name: Step
+// Desc: Advances the simulation by one frame: integrate, collide the bodies with
+//       each other, then resolve them against the static terrain
+//------------------------------------------------------------------------------------
+void PhysicsWorld::Step(const CollisionMesh *terrain) {
+    BeginStep();
+    
+    if(terrain != nullptr)
+        CollideTerrain(terrain);
+}
+
+//------------------------------------------------------------------------------------
+// Name: Step
+// Desc: Advances the simulation by one frame against the resident chunks of a
+//       streamed terrain
+//------------------------------------------------------------------------------------
+void PhysicsWorld::Step(const ChunkedTerrain *terrain) {
+    BeginStep();
+    
+    if(terrain != nullptr)
+        CollideTerrain(terrain);
+}
+
+//------------------------------------------------------------------------------------
+// Name: BeginStep
+// Desc: Everything in a step up to the terrain: integrate, then collide the
+//       bodies with each other
+//------------------------------------------------------------------------------------
+void PhysicsWorld::BeginStep() {
+    // Nothing from the last step is needed any more
+    scratch.Reset();
+    
+    pairs.Reserve(&scratch, NumBodies());
+    candidates.Reserve(&scratch, PHYSICS_CANDIDATES_RESERVE);
+    requery_candidates.Reserve(&scratch, PHYSICS_CANDIDATES_RESERVE);
+    body_chunks.Reserve(&scratch, PHYSICS_CHUNKS_RESERVE);
+    requery_chunks.Reserve(&scratch, PHYSICS_CHUNKS_RESERVE);
+    terrain_contacts.Reserve(&scratch, NumBodies());
+    
+    Integrate();
+    BroadPhase();
+    NarrowPhase();
+}
+
+//------------------------------------------------------------------------------------
+// Name: Integrate
+// Desc: Applies velocity and the lazy downwards gravity to every body
+//------------------------------------------------------------------------------------
+void PhysicsWorld::Integrate() {
+    unsigned int n = NumBodies();
+    
+    for(unsigned int i = 0; i < n; i++) {
+        pos_x[i] += vel_x[i];
+        pos_y[i] += vel_y[i];
+        pos_z[i] += vel_z[i];
+        
+        vel_y[i] -= gravity;
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Name: BroadPhase
+// Desc: Sort-and-sweep over the body AABBs along the X axis.
+//       Insertion sort is used since the order from the last step is
+//       almost always still (nearly) correct
+//------------------------------------------------------------------------------------
+void PhysicsWorld::BroadPhase() {
+    unsigned int n = NumBodies();
+    
+    for(unsigned int i = 0; i < n; i++) {
+        sweep_min[i] = pos_x[i] - radius[i];
+        sweep_max[i] = pos_x[i] + radius[i];
+    }
+    
+    for(unsigned int i = 1; i < n; i++) {
+        unsigned int body = sweep_order[i];
+        float key = sweep_min[body];
+        unsigned int j = i;
+        
+        while(j > 0 && sweep_min[sweep_order[j - 1]] > key) {
+            sweep_order[j] = sweep_order[j - 1];
+            j--;
+        }
+        
+        sweep_order[j] = body;
+    }
+    
+    pairs.clear();
+    
+    for(unsigned int i = 0; i < n; i++) {
+        unsigned int a = sweep_order[i];
+        
+        for(unsigned int j = i + 1; j < n; j++) {
+            unsigned int b = sweep_order[j];
+            
+            // Everything further along the sweep starts after A ends
+            if(sweep_min[b] > sweep_max[a])
+                break;
+            
+            // Reject on the remaining two axes before the narrowphase
+            float rr = radius[a] + radius[b];
+            
+            if(fabsf(pos_y[a] - pos_y[b]) > rr || fabsf(pos_z[a] - pos_z[b]) > rr)
+                continue;
+            
+            body_pair pair = { a, b };
+            pairs.push_back(pair);
+        }
+    }
+    
+    num_broadphase_pairs = (unsigned int)pairs.size();
+}
+
+//------------------------------------------------------------------------------------
+// Name: NarrowPhase
+// Desc: Runs the sphere-sphere test on each broadphase pair, separating the
+//       bodies by inverse mass and removing their approaching velocity
+//------------------------------------------------------------------------------------
+void PhysicsWorld::NarrowPhase() {
+    CollisionPacket collisionPacket;
+    
+    num_body_contacts = 0;
+    
+    for(unsigned int i = 0; i < pairs.size(); i++) {
+        unsigned int a = pairs[i].a;
+        unsigned int b = pairs[i].b;
+        
+        float w = inv_mass[a] + inv_mass[b];
+        
+        if(w <= 0.0f)
+            continue;
+        
+        bool result = IsIntersectingSphereSphere(
+            collisionPacket,
+            GetPosition(a), radius[a],
+            GetPosition(b), radius[b]
+            );
+        
+        if(!result)
+            continue;
+        
+        num_body_contacts++;
+        
+        vec3 n = collisionPacket.normal;
+        
+        // Push the bodies apart, the lighter one moving further
+        vec3 push = n * (collisionPacket.distance / w);
+        
+        MoveBody(a, push * inv_mass[a]);
+        MoveBody(b, push * -inv_mass[b]);
+        
+        // Remove the closing velocity along the contact normal (perfectly inelastic)
+        float vn = (vel_x[a] - vel_x[b]) * n.x + (vel_y[a] - vel_y[b]) * n.y + (vel_z[a] - vel_z[b]) * n.z;
+        
+        if(vn < 0.0f) {
+            float j = -vn / w;
+            
+            vel_x[a] += n.x * j * inv_mass[a];
+            vel_y[a] += n.y * j * inv_mass[a];
+            vel_z[a] += n.z * j * inv_mass[a];
+            
+            vel_x[b] -= n.x * j * inv_mass[b];
+            vel_y[b] -= n.y * j * inv_mass[b];
+            vel_z[b] -= n.z * j * inv_mass[b];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Name: IsInsideCache
+// Desc: Whether the sphere's bounding box lies within the box a body's cached
+//       terrain leaves were gathered for
+//------------------------------------------------------------------------------------
+static bool IsInsideCache(const terrain_query_cache& cache, vec3 P, float r) {
+    return
+        P.x - r >= cache.bounds_min.x && P.x + r <= cache.bounds_max.x &&
+        P.y - r >= cache.bounds_min.y && P.y + r <= cache.bounds_max.y &&
+        P.z - r >= cache.bounds_min.z && P.z + r <= cache.bounds_max.z;
+}
+
+//------------------------------------------------------------------------------------
+// Name: CollideTerrain
+// Desc: Resolves every body against the static terrain
+//------------------------------------------------------------------------------------
+void PhysicsWorld::CollideTerrain(const CollisionMesh *terrain) {
+    num_terrain_contacts = 0;
+    num_terrain_queries = 0;
+    num_terrain_cache_hits = 0;
+    
+    next_terrain_cache_leaves.clear();
+    
+    for(unsigned int i = 0; i < NumBodies(); i++)
+        CollideBody(i, terrain, 0, true);
+    
+    terrain_cache_leaves.swap(next_terrain_cache_leaves);
+}
+
+//------------------------------------------------------------------------------------
+// Name: CollideTerrain
+// Desc: Resolves every body against the resident chunks it overlaps. A body
+//       inside one chunk keeps its leaf cache for that chunk; one straddling a
+//       border is resolved against each chunk in turn, without the cache.
+//       A body over a chunk that hasn't streamed in yet finds no terrain there
+//------------------------------------------------------------------------------------
+void PhysicsWorld::CollideTerrain(const ChunkedTerrain *terrain) {
+    num_terrain_contacts = 0;
+    num_terrain_queries = 0;
+    num_terrain_cache_hits = 0;
+    
+    next_terrain_cache_leaves.clear();
+    
+    for(unsigned int i = 0; i < NumBodies(); i++) {
+        vec3 P = GetPosition(i);
+        float r = radius[i];
+        
+        body_chunks.clear();
+        terrain->QueryChunks(P - vec3(r), P + vec3(r), body_chunks);
+        
+        bool use_cache = body_chunks.size() == 1;
+        
+        // As in CollideBody, a push can move the body into chunks it didn't overlap
+        vec3 queried = P;
+        unsigned int first_untested = 0;
+        
+        while(first_untested < body_chunks.size()) {
+            for(unsigned int c = first_untested; c < body_chunks.size(); c++)
+                CollideBody(i, body_chunks[c]->mesh, body_chunks[c]->serial, use_cache && c == 0);
+            
+            first_untested = body_chunks.size();
+            
+            vec3 pushed = GetPosition(i);
+            
+            if(pushed == queried)
+                break;
+            
+            queried = pushed;
+            requery_chunks.clear();
+            terrain->QueryChunks(pushed - vec3(r), pushed + vec3(r), requery_chunks);
+            
+            for(unsigned int n = 0; n < requery_chunks.size(); n++) {
+                const terrain_chunk * const *tested = body_chunks.data();
+                
+                if(std::find(tested, tested + first_untested, requery_chunks[n]) == tested + first_untested)
+                    body_chunks.push_back(requery_chunks[n]);
+            }
+        }
+        
+        if(body_chunks.size() != 1)
+            terrain_cache[i].mesh = nullptr;
+    }
+    
+    terrain_cache_leaves.swap(next_terrain_cache_leaves);
+}
+
+//------------------------------------------------------------------------------------
+// Name: CollideBody
+// Desc: Resolves one body against one terrain mesh using the sphere-triangle
+//       test, with the same response as the player always had.
+//       Bodies move little per step, so with use_cache each keeps the BVH leaves
+//       around it in a box PHYSICS_TERRAIN_CACHE_MARGIN larger than itself, and
+//       only walks the BVH again once it leaves that box or the mesh changes.
+//       The candidates are the same either way
+//------------------------------------------------------------------------------------
+void PhysicsWorld::CollideBody(unsigned int i, const CollisionMesh *mesh, unsigned int serial, bool use_cache) {
+    CollisionPacket collisionPacket;
+    
+    const vec3 *tri = mesh->triangles.data();
+    
+    float r = radius[i];
+    vec3 P = GetPosition(i);
+    
+    candidates.clear();
+    
+    if(use_cache) {
+        terrain_query_cache &cache = terrain_cache[i];
+        unsigned int first = (unsigned int)next_terrain_cache_leaves.size();
+        
+        bool is_inside_cache = cache.mesh == mesh && cache.serial == serial && IsInsideCache(cache, P, r);
+        
+        if(is_inside_cache) {
+            const unsigned int *leaves = terrain_cache_leaves.data() + cache.first;
+            next_terrain_cache_leaves.insert(next_terrain_cache_leaves.end(), leaves, leaves + cache.count);
+            
+            num_terrain_cache_hits++;
+        } else {
+            cache.mesh = mesh;
+            cache.serial = serial;
+            cache.bounds_min = P - vec3(r + PHYSICS_TERRAIN_CACHE_MARGIN);
+            cache.bounds_max = P + vec3(r + PHYSICS_TERRAIN_CACHE_MARGIN);
+            
+            mesh->QueryBoxLeaves(cache.bounds_min, cache.bounds_max, next_terrain_cache_leaves);
+            
+            num_terrain_queries++;
+        }
+        
+        cache.first = first;
+        cache.count = (unsigned int)next_terrain_cache_leaves.size() - first;
+        
+        // Only test the triangles near the body
+        mesh->QuerySphereLeaves(P, r, next_terrain_cache_leaves.data() + cache.first, cache.count, candidates);
+    } else {
+        mesh->QuerySphere(P, r, candidates);
+        
+        num_terrain_queries++;
+    }
+    
+    // A push can move the body next to triangles outside the box it was queried
+    // with, so after any push query again and test the triangles that are new
+    vec3 queried = P;
+    unsigned int first_untested = 0;
+    
+    while(first_untested < candidates.size()) {
+        for(unsigned int c = first_untested; c < candidates.size(); c++) {
+            unsigned int k = candidates[c];
+            
+            DEBUG_DRAW_TRIANGLE(DEBUG_DRAW_CANDIDATES, tri[k*3], tri[k*3+1], tri[k*3+2], DEBUG_COLOR_CANDIDATE);
+            
+            bool result = IsIntersectingSphereTriangle(
+                collisionPacket,
+                tri[k*3],
+                tri[k*3+1],
+                tri[k*3+2],
+                GetPosition(i),
+                r
+                );
+            
+            if(!result)
+                continue;
+            
+            num_terrain_contacts++;
+            
+            terrain_contact contact = { i, k, mesh, collisionPacket.normal, collisionPacket.distance + r };
+            terrain_contacts.push_back(contact);
+            
+            // The contact lies on the triangle plane, distance along the normal from the centre
+            DEBUG_DRAW_TRIANGLE(DEBUG_DRAW_CONTACTS, tri[k*3], tri[k*3+1], tri[k*3+2], DEBUG_COLOR_HIT);
+            DEBUG_DRAW_LINE(DEBUG_DRAW_CONTACTS,
+                GetPosition(i) + collisionPacket.normal * collisionPacket.distance,
+                GetPosition(i) + collisionPacket.normal * (collisionPacket.distance + 1.0f),
+                DEBUG_COLOR_NORMAL);
+            
+            // If colliding with floor or ramp, kill gravity
+            if(collisionPacket.normal.y > 0.5f)
+                vel_y[i] = 0.0f;
+            
+            // Push collision sphere away from the intersected triangle(s)
+            MoveBody(i, contact.normal * contact.depth);
+        }
+        
+        first_untested = candidates.size();
+        
+        vec3 pushed = GetPosition(i);
+        
+        if(pushed == queried)
+            break;
+        
+        queried = pushed;
+        requery_candidates.clear();
+        
+        if(use_cache && IsInsideCache(terrain_cache[i], pushed, r)) {
+            const terrain_query_cache &cache = terrain_cache[i];
+            mesh->QuerySphereLeaves(pushed, r, next_terrain_cache_leaves.data() + cache.first, cache.count, requery_candidates);
+        } else {
+            mesh->QuerySphere(pushed, r, requery_candidates);
+            num_terrain_queries++;
+        }
+        
+        for(unsigned int n = 0; n < requery_candidates.size(); n++) {
+            const unsigned int *tested = candidates.data();
+            
+            if(std::find(tested, tested + first_untested, requery_candidates[n]) == tested + first_untested)
+                candidates.push_back(requery_candidates[n]);
+        }
+    }
+}
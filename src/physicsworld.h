@@ -0,0 +1,104 @@
+#pragma once
+
+#include "common.h"
+#include "arena.h"
+#include "chunkedterrain.h"
+#include "collision.h"
+#include "collisionmesh.h"
+
+typedef struct {
+    unsigned int a;
+    unsigned int b;
+} body_pair;
+
+typedef struct {
+    unsigned int body;
+    unsigned int triangle; // In mesh, the terrain or the chunk it belongs to
+    
+    const CollisionMesh *mesh;
+    
+    vec3 normal;
+    float depth; // How far the body was pushed out along the normal
+} terrain_contact;
+
+typedef struct {
+    // Mesh the leaves belong to, and its ChunkedTerrain serial (0 otherwise)
+    const CollisionMesh *mesh;
+    unsigned int serial;
+    
+    // Expanded box around the body that the leaves were gathered for
+    vec3 bounds_min;
+    vec3 bounds_max;
+    
+    // Range of the leaves in the cached leaf list
+    unsigned int first;
+    unsigned int count;
+} terrain_query_cache;
+
+class PhysicsWorld {
+public:
+    PhysicsWorld();
+    
+    unsigned int AddBody(vec3 position, float radius, float mass);
+    
+    void ResetBody(unsigned int body, vec3 position);
+    void MoveBody(unsigned int body, vec3 delta);
+    
+    vec3 GetPosition(unsigned int body) const;
+    unsigned int NumBodies() const { return (unsigned int)radius.size(); }
+    
+    void Step(const CollisionMesh *terrain);
+    void Step(const ChunkedTerrain *terrain);
+    
+    // Body pool, stored as a structure of arrays so each pass only touches the fields it needs
+    std::vector<float> pos_x, pos_y, pos_z;
+    std::vector<float> vel_x, vel_y, vel_z;
+    std::vector<float> radius;
+    std::vector<float> inv_mass; // 0 = immovable
+    
+    float gravity;
+    
+    // Statistics from the last step
+    unsigned int num_broadphase_pairs;
+    unsigned int num_body_contacts;
+    unsigned int num_terrain_contacts;
+    unsigned int num_terrain_queries;    // Bodies that walked the terrain BVH
+    unsigned int num_terrain_cache_hits; // Bodies answered from their cached leaves
+    
+    // Contacts against the terrain from the last step, valid until the next one
+    ArenaArray<terrain_contact> terrain_contacts;
+    
+    // Scratch memory for a step (pairs, candidates, contacts), reset at the start
+    // of the next one. After the first few steps it no longer touches the heap
+    FrameArena scratch;
+private:
+    void BeginStep();
+    void Integrate();
+    void BroadPhase();
+    void NarrowPhase();
+    void CollideTerrain(const CollisionMesh *terrain);
+    void CollideTerrain(const ChunkedTerrain *terrain);
+    void CollideBody(unsigned int body, const CollisionMesh *mesh, unsigned int serial, bool use_cache);
+    
+    // Sort-and-sweep state along the X axis. The order persists between
+    // steps, so it is usually already nearly sorted
+    std::vector<float> sweep_min;
+    std::vector<float> sweep_max;
+    std::vector<unsigned int> sweep_order;
+    
+    ArenaArray<body_pair> pairs;
+    
+    // Terrain triangles near the body being resolved, those found again after it
+    // was pushed, and the chunks they come from
+    ArenaArray<unsigned int> candidates;
+    ArenaArray<unsigned int> requery_candidates;
+    ArenaArray<const terrain_chunk *> body_chunks;
+    ArenaArray<const terrain_chunk *> requery_chunks;
+    
+    // Each body's terrain BVH leaves from an earlier step, reused while the body
+    // stays inside the box they were gathered for. The leaf lists are rebuilt
+    // into the second buffer every step, then the two are swapped
+    std::vector<terrain_query_cache> terrain_cache;
+    std::vector<unsigned int> terrain_cache_leaves;
+    std::vector<unsigned int> next_terrain_cache_leaves;
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cfloat>
+#include <stdint.h>
+
+#include "common.h"
+
+//------------------------------------------------------------------------
+// Scalar/vector policies for the templated collision kernels.
+// A policy is picked as a template argument, so there is no runtime
+// dispatch; each kernel is compiled once per policy it is used with.
+//
+//   FloatPrecision  - glm::vec3, the fastest path
+//   DoublePrecision - glm::dvec3, for large worlds
+//   FixedPrecision  - 47.16 fixed point, bit-identical on every platform
+//                     for lockstep simulations
+//------------------------------------------------------------------------
+
+// Longest triangle edge the fixed-point sphere-triangle test stays exact for.
+// Its edge tests square a vector of length |A|*|AB|^2 (A being a vertex
+// relative to the sphere centre), so the sums reach 2*|A|^2*|AB|^4, which
+// must stay under 2^47. With edges up to 64 units that allows vertices up
+// to 2048 units from the sphere centre: spheres up to about 1900 units
+#define FIXED_MAX_TRIANGLE_EDGE 64.0
+
+//------------------------------------------------------------------------
+// Name: SaturateRaw
+// Desc: Clamps a 128-bit intermediate to the 64-bit fixed-point range
+//------------------------------------------------------------------------
+inline int64_t SaturateRaw(__int128 value) {
+    if(value > INT64_MAX)
+        return INT64_MAX;
+    
+    if(value < INT64_MIN)
+        return INT64_MIN;
+    
+    return (int64_t)value;
+}
+
+//------------------------------------------------------------------------
+// Fixed-point scalar with 16 fractional bits in a 64-bit integer.
+// Products are taken in 128 bits, and every operation saturates rather
+// than wrapping, so a value out of range stays the largest one instead
+// of flipping sign. Keep triangles within FIXED_MAX_TRIANGLE_EDGE and
+// geometry origin-relative so nothing saturates in the first place
+//------------------------------------------------------------------------
+class Fixed {
+public:
+    static const int FRACTION_BITS = 16;
+    
+    Fixed() : raw(0) {}
+    Fixed(int value) : raw((int64_t)value * ((int64_t)1 << FRACTION_BITS)) {}
+    explicit Fixed(float value) : raw((int64_t)llround((double)value * (1 << FRACTION_BITS))) {}
+    explicit Fixed(double value) : raw((int64_t)llround(value * (1 << FRACTION_BITS))) {}
+    
+    static Fixed FromRaw(int64_t raw) { Fixed f; f.raw = raw; return f; }
+    
+    double ToDouble() const { return (double)raw / (1 << FRACTION_BITS); }
+    
+    Fixed operator-() const { return FromRaw(SaturateRaw(-(__int128)raw)); }
+    
+    Fixed& operator+=(Fixed o) { raw = SaturateRaw((__int128)raw + o.raw); return *this; }
+    Fixed& operator-=(Fixed o) { raw = SaturateRaw((__int128)raw - o.raw); return *this; }
+    
+    int64_t raw;
+};
+
+inline Fixed operator+(Fixed a, Fixed b) { return Fixed::FromRaw(SaturateRaw((__int128)a.raw + b.raw)); }
+inline Fixed operator-(Fixed a, Fixed b) { return Fixed::FromRaw(SaturateRaw((__int128)a.raw - b.raw)); }
+
+// Both raw values are under 2^63, so the 128-bit product itself can't overflow
+inline Fixed operator*(Fixed a, Fixed b) {
+    return Fixed::FromRaw(SaturateRaw(((__int128)a.raw * b.raw) >> Fixed::FRACTION_BITS));
+}
+
+// Dividing by zero saturates instead of trapping, which __int128 division would
+inline Fixed operator/(Fixed a, Fixed b) {
+    if(b.raw == 0)
+        return Fixed::FromRaw(a.raw < 0 ? INT64_MIN : INT64_MAX);
+    
+    return Fixed::FromRaw(SaturateRaw(((__int128)a.raw << Fixed::FRACTION_BITS) / b.raw));
+}
+
+inline bool operator<(Fixed a, Fixed b)  { return a.raw < b.raw; }
+inline bool operator>(Fixed a, Fixed b)  { return a.raw > b.raw; }
+inline bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+inline bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+inline bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+inline bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+
+//------------------------------------------------------------------------
+// Name: sqrt
+// Desc: Bit-by-bit integer square root, exact and deterministic
+//------------------------------------------------------------------------
+inline Fixed sqrt(Fixed a) {
+    if(a.raw <= 0)
+        return Fixed();
+    
+    unsigned __int128 n = (unsigned __int128)a.raw << Fixed::FRACTION_BITS;
+    unsigned __int128 result = 0;
+    unsigned __int128 bit = (unsigned __int128)1 << 126;
+    
+    while(bit > n)
+        bit >>= 2;
+    
+    while(bit != 0) {
+        if(n >= result + bit) {
+            n -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else {
+            result >>= 1;
+        }
+        
+        bit >>= 2;
+    }
+    
+    return Fixed::FromRaw((int64_t)result);
+}
+
+struct FixedVec3 {
+    FixedVec3() {}
+    FixedVec3(Fixed x, Fixed y, Fixed z) : x(x), y(y), z(z) {}
+    
+    FixedVec3 operator-() const { return FixedVec3(-x, -y, -z); }
+    
+    FixedVec3& operator+=(const FixedVec3& o) { x += o.x; y += o.y; z += o.z; return *this; }
+    
+    Fixed x, y, z;
+};
+
+inline FixedVec3 operator+(const FixedVec3& a, const FixedVec3& b) { return FixedVec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline FixedVec3 operator-(const FixedVec3& a, const FixedVec3& b) { return FixedVec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline FixedVec3 operator*(const FixedVec3& a, Fixed s) { return FixedVec3(a.x * s, a.y * s, a.z * s); }
+inline FixedVec3 operator/(const FixedVec3& a, Fixed s) { return FixedVec3(a.x / s, a.y / s, a.z / s); }
+
+inline Fixed dot(const FixedVec3& a, const FixedVec3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline FixedVec3 cross(const FixedVec3& a, const FixedVec3& b) {
+    return FixedVec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// A vector too short to square without underflowing to zero comes back unchanged
+inline FixedVec3 normalize(const FixedVec3& a) {
+    Fixed length = sqrt(dot(a, a));
+    
+    if(length.raw == 0)
+        return a;
+    
+    return a / length;
+}
+
+//------------------------------------------------------------------------
+// Policies. Each maps between its own types and double-precision world
+// coordinates, which is what the origin-relative mesh storage uses, and
+// gives the longest triangle edge its kernels stay in range for
+//------------------------------------------------------------------------
+struct FloatPrecision {
+    typedef float scalar;
+    typedef glm::vec3 vector;
+    
+    static const char *Name() { return "float"; }
+    static double MaxTriangleEdge() { return DBL_MAX; }
+    
+    static scalar ToScalar(double s) { return (scalar)s; }
+    static double FromScalar(scalar s) { return s; }
+    
+    static vector ToVector(const glm::dvec3& v) { return vector(v); }
+    static glm::dvec3 FromVector(const vector& v) { return glm::dvec3(v); }
+};
+
+struct DoublePrecision {
+    typedef double scalar;
+    typedef glm::dvec3 vector;
+    
+    static const char *Name() { return "double"; }
+    static double MaxTriangleEdge() { return DBL_MAX; }
+    
+    static scalar ToScalar(double s) { return s; }
+    static double FromScalar(scalar s) { return s; }
+    
+    static vector ToVector(const glm::dvec3& v) { return v; }
+    static glm::dvec3 FromVector(const vector& v) { return v; }
+};
+
+struct FixedPrecision {
+    typedef Fixed scalar;
+    typedef FixedVec3 vector;
+    
+    static const char *Name() { return "fixed"; }
+    static double MaxTriangleEdge() { return FIXED_MAX_TRIANGLE_EDGE; }
+    
+    static scalar ToScalar(double s) { return Fixed(s); }
+    static double FromScalar(scalar s) { return s.ToDouble(); }
+    
+    static vector ToVector(const glm::dvec3& v) { return vector(Fixed(v.x), Fixed(v.y), Fixed(v.z)); }
+    static glm::dvec3 FromVector(const vector& v) { return glm::dvec3(v.x.ToDouble(), v.y.ToDouble(), v.z.ToDouble()); }
+};
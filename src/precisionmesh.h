@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+
+#include "collisionkernel.h"
+#include "collisionmesh.h"
+
+//------------------------------------------------------------------------
+// Triangle storage in a precision policy's own types, relative to a
+// double-precision origin. Far from the world origin, subtracting the
+// origin first keeps the local coordinates small enough for float or
+// fixed point.
+//
+// Give it the triangles in double precision for a large world; a float
+// CollisionMesh has already lost whatever precision its coordinates had.
+// Candidates come from a float BVH of the local coordinates, searched
+// with the sphere padded by a few float ulps at the largest coordinate
+// involved, so rounding never drops a triangle the sphere can touch.
+//
+// Triangles with an edge longer than the policy allows are left out
+// when the mesh is built (and counted), and a candidate with a vertex
+// beyond the longest edge plus the radius is skipped before the kernel,
+// since no part of it can reach the sphere. That keeps the fixed-point
+// kernel within the range FIXED_MAX_TRIANGLE_EDGE is worked out for
+//------------------------------------------------------------------------
+template<typename Precision>
+class PrecisionMesh {
+public:
+    typedef typename Precision::scalar scalar;
+    typedef typename Precision::vector vector;
+    typedef BasicCollisionPacket<Precision> packet;
+    
+    PrecisionMesh(const CollisionMesh *source, glm::dvec3 origin = glm::dvec3(0.0)) : origin(origin) {
+        std::vector<glm::dvec3> world_triangles;
+        world_triangles.reserve(source->triangles.size());
+        
+        for(size_t i = 0; i < source->triangles.size(); i++)
+            world_triangles.push_back(glm::dvec3(source->triangles[i]));
+        
+        Build(world_triangles);
+    }
+    
+    PrecisionMesh(const std::vector<glm::dvec3>& world_triangles, glm::dvec3 origin = glm::dvec3(0.0)) : origin(origin) {
+        Build(world_triangles);
+    }
+    
+    vector ToLocal(const glm::dvec3& world) const { return Precision::ToVector(world - origin); }
+    glm::dvec3 ToWorld(const vector& local) const { return Precision::FromVector(local) + origin; }
+    
+    //--------------------------------------------------------------------
+    // Name: QuerySphere
+    // Desc: Runs the sphere-triangle kernel against every triangle near
+    //       a sphere given in local coordinates, appending the contacts.
+    //       Returns the number of contacts found
+    //--------------------------------------------------------------------
+    unsigned int QuerySphere(std::vector<packet>& contacts, const vector& P, scalar r) {
+        glm::dvec3 local = Precision::FromVector(P);
+        double local_r = Precision::FromScalar(r);
+        
+        // Both the BVH and the sphere centre are rounded to float
+        double magnitude = std::max(bvh_magnitude, std::max(fabs(local.x), std::max(fabs(local.y), fabs(local.z))));
+        double pad = (magnitude + local_r) * 4.0 * FLT_EPSILON;
+        
+        candidates.clear();
+        bvh.QuerySphere(vec3(local), (float)(local_r + pad), candidates);
+        
+        // Every point of a triangle is within its longest edge of each vertex
+        scalar reach = Precision::ToScalar(max_edge + local_r + pad);
+        scalar reach_squared = reach * reach;
+        
+        unsigned int num_contacts = 0;
+        packet contact;
+        
+        for(size_t c = 0; c < candidates.size(); c++) {
+            unsigned int k = candidates[c];
+            vector A = triangles[k*3] - P;
+            
+            if(dot(A, A) > reach_squared)
+                continue;
+            
+            if(IsIntersectingSphereTriangleT<Precision>(contact, triangles[k*3], triangles[k*3+1], triangles[k*3+2], P, r)) {
+                contacts.push_back(contact);
+                num_contacts++;
+            }
+        }
+        
+        return num_contacts;
+    }
+    
+    glm::dvec3 origin;
+    
+    // Triangle soup in local coordinates, three vertices per triangle, in the BVH's order
+    std::vector<vector> triangles;
+    
+    unsigned int num_rejected; // Triangles left out for being too large for the policy
+private:
+    //--------------------------------------------------------------------
+    // Name: Build
+    // Desc: Stores the triangles relative to the origin, and builds the
+    //       BVH over them rounded to float. Triangles with an edge over
+    //       the policy's limit are left out
+    //--------------------------------------------------------------------
+    void Build(const std::vector<glm::dvec3>& world_triangles) {
+        std::vector<glm::dvec3> accepted;
+        accepted.reserve(world_triangles.size());
+        
+        num_rejected = 0;
+        max_edge = 0.0;
+        
+        for(size_t i = 0; i + 2 < world_triangles.size(); i += 3) {
+            double edge = std::max(glm::length(world_triangles[i+1] - world_triangles[i]),
+                std::max(glm::length(world_triangles[i+2] - world_triangles[i+1]), glm::length(world_triangles[i] - world_triangles[i+2])));
+            
+            if(edge > Precision::MaxTriangleEdge()) {
+                num_rejected++;
+                continue;
+            }
+            
+            max_edge = std::max(max_edge, edge);
+            
+            for(int k = 0; k < 3; k++)
+                accepted.push_back(world_triangles[i+k]);
+            
+            bvh.AddTriangle(
+                vec3(world_triangles[i] - origin),
+                vec3(world_triangles[i+1] - origin),
+                vec3(world_triangles[i+2] - origin)
+                );
+        }
+        
+        if(num_rejected > 0)
+            printf("Left out %u triangles with edges over %g units, too large for %s precision\n",
+                num_rejected, Precision::MaxTriangleEdge(), Precision::Name());
+        
+        std::vector<unsigned int> order;
+        bvh.Build(&order);
+        
+        triangles.reserve(order.size() * 3);
+        
+        for(size_t i = 0; i < order.size(); i++) {
+            for(int k = 0; k < 3; k++)
+                triangles.push_back(ToLocal(accepted[order[i]*3+k]));
+        }
+        
+        bvh_magnitude = 0.0;
+        
+        for(int k = 0; k < 3 && !order.empty(); k++)
+            bvh_magnitude = std::max(bvh_magnitude, std::max(fabs((double)bvh.bounds_min[k]), fabs((double)bvh.bounds_max[k])));
+    }
+    
+    // Float copy of the local triangles, only used to find candidates
+    CollisionMesh bvh;
+    double bvh_magnitude; // Largest absolute coordinate in the BVH
+    double max_edge;      // Longest edge of the triangles kept
+    
+    std::vector<unsigned int> candidates;
+};
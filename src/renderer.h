@@ -0,0 +1,50 @@
+#pragma once
+
+#include "glcommon.h"
+#include "debugdraw.h"
+#include "skybox.h"
+#include "staticmesh.h"
+
+typedef struct {
+    vec3 position;
+    float radius;
+    
+    vec4 color;
+} sphere_instance;
+
+// Work submitted since the last BeginFrame
+typedef struct {
+    unsigned int draw_calls;
+    unsigned int state_changes; // Renderer state calls, plus one per material an asset sets up itself
+    unsigned int triangles;
+} render_stats;
+
+// Makes a GL state call (bind, enable/disable, material, matrix or uniform)
+// from a Renderer method, counting it in the frame's stats
+#define COUNTED_STATE(call) do { call; stats.state_changes++; } while(0)
+
+//------------------------------------------------------------------------
+// Common interface of the rendering backends.
+//   FixedRenderer - the OpenGL 3.0 fixed-function pipeline
+//   CoreRenderer  - an OpenGL 3.3 core-profile pipeline with shaders,
+//                   uniform buffers and instanced drawing
+//------------------------------------------------------------------------
+class Renderer {
+public:
+    Renderer() { memset(&stats, 0, sizeof(stats)); }
+    virtual ~Renderer() {}
+    
+    virtual void Resize(int width, int height) = 0;
+    
+    virtual void BeginFrame(const mat4& view) = 0;
+    
+    virtual void DrawSkybox(Skybox *skybox) = 0;
+    virtual void DrawStaticMesh(StaticMesh *mesh) = 0;
+    virtual void ReleaseStaticMesh(StaticMesh *mesh) = 0; // Before deleting a mesh that was drawn
+    virtual void DrawSpheres(const sphere_instance *spheres, unsigned int count) = 0;
+    
+    // Line list in world space, drawn over everything in one call
+    virtual void DrawDebugLines(const debug_vertex *vertices, unsigned int count) = 0;
+    
+    render_stats stats;
+};
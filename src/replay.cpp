@@ -0,0 +1,161 @@
+#include "replay.h"
+
+#include <stdint.h>
+
+#define REPLAY_HEADER_SIZE (4 + 4 + 4 + 64 + 64)
+#define REPLAY_FRAME_SIZE  (1 + 4 * 2 + 4 * 3 + 4)
+
+//------------------------------------------------------------------------------------
+// Name: ReplayRecorder
+// Desc: Constructor for the ReplayRecorder class.
+//       Opens the file and writes a header with a placeholder frame count.
+//       If the recorder is never closed, Replay counts the frames in the file
+//------------------------------------------------------------------------------------
+ReplayRecorder::ReplayRecorder(const char *filepath, const char *terrain_directory, const char *terrain_filename) {
+    num_frames = 0;
+    file = fopen(filepath, "wb");
+    
+    if(!file) {
+        printf("Could not open replay file for writing:\n%s\n", filepath);
+        return;
+    }
+    
+    unsigned char header[REPLAY_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    
+    uint32_t version = REPLAY_VERSION;
+    
+    memcpy(header, REPLAY_MAGIC, 4);
+    memcpy(header + 4, &version, 4);
+    strncpy((char *)header + 12, terrain_directory, 63);
+    strncpy((char *)header + 76, terrain_filename, 63);
+    
+    fwrite(header, sizeof(header), 1, file);
+}
+
+//------------------------------------------------------------------------------------
+// Name: RecordFrame
+// Desc: Appends the input used for a frame and the state it produced
+//------------------------------------------------------------------------------------
+void ReplayRecorder::RecordFrame(const game_input& input, const Game& game) {
+    if(!file)
+        return;
+    
+    unsigned char record[REPLAY_FRAME_SIZE];
+    uint32_t state_hash = game.StateHash();
+    
+    record[0] = input.buttons;
+    memcpy(record + 1, &input.mouse_dx, 4);
+    memcpy(record + 5, &input.mouse_dy, 4);
+    memcpy(record + 9, &game.player_pos.x, 4);
+    memcpy(record + 13, &game.player_pos.y, 4);
+    memcpy(record + 17, &game.player_pos.z, 4);
+    memcpy(record + 21, &state_hash, 4);
+    
+    fwrite(record, sizeof(record), 1, file);
+    
+    num_frames++;
+}
+
+//------------------------------------------------------------------------------------
+// Name: ~ReplayRecorder
+// Desc: Patches the final frame count into the header and closes the file
+//------------------------------------------------------------------------------------
+ReplayRecorder::~ReplayRecorder() {
+    if(!file)
+        return;
+    
+    uint32_t count = num_frames;
+    
+    fseek(file, 8, SEEK_SET);
+    fwrite(&count, 4, 1, file);
+    fclose(file);
+}
+
+//------------------------------------------------------------------------------------
+// Name: Replay
+// Desc: Constructor for the Replay class. Reads a whole recording into memory.
+//       A recording whose header says 0 frames, or fewer than the file holds,
+//       was not closed (e.g. the demo crashed), so every whole frame is read
+//------------------------------------------------------------------------------------
+Replay::Replay(const char *filepath) {
+    loaded = false;
+    terrain_directory[0] = '\0';
+    terrain_filename[0] = '\0';
+    
+    FILE *replay_file = fopen(filepath, "rb");
+    
+    if(!replay_file) {
+        printf("Could not open replay file:\n%s\n", filepath);
+        return;
+    }
+    
+    unsigned char header[REPLAY_HEADER_SIZE];
+    uint32_t version, count;
+    
+    if(fread(header, sizeof(header), 1, replay_file) != 1 || memcmp(header, REPLAY_MAGIC, 4) != 0) {
+        printf("Not a replay file:\n%s\n", filepath);
+        fclose(replay_file);
+        return;
+    }
+    
+    memcpy(&version, header + 4, 4);
+    memcpy(&count, header + 8, 4);
+    
+    if(version != REPLAY_VERSION) {
+        printf("Unsupported replay version %u:\n%s\n", version, filepath);
+        fclose(replay_file);
+        return;
+    }
+    
+    fseek(replay_file, 0, SEEK_END);
+    long file_size = ftell(replay_file);
+    fseek(replay_file, REPLAY_HEADER_SIZE, SEEK_SET);
+    
+    uint32_t count_in_file = (uint32_t)((file_size - REPLAY_HEADER_SIZE) / REPLAY_FRAME_SIZE);
+    
+    if(count < count_in_file) {
+        printf("Replay header says %u frames, reading the %u in the file:\n%s\n", count, count_in_file, filepath);
+        count = count_in_file;
+    } else if(count > count_in_file) {
+        printf("Replay file is truncated at frame %u:\n%s\n", count_in_file, filepath);
+        count = count_in_file;
+    }
+    
+    memcpy(terrain_directory, header + 12, 64);
+    memcpy(terrain_filename, header + 76, 64);
+    terrain_directory[63] = '\0';
+    terrain_filename[63] = '\0';
+    
+    frames.resize(count);
+    
+    for(uint32_t i = 0; i < count; i++) {
+        unsigned char record[REPLAY_FRAME_SIZE];
+        
+        if(fread(record, sizeof(record), 1, replay_file) != 1) {
+            printf("Replay file is truncated at frame %u:\n%s\n", i, filepath);
+            frames.resize(i);
+            break;
+        }
+        
+        replay_frame &frame = frames[i];
+        
+        frame.input.buttons = record[0];
+        memcpy(&frame.input.mouse_dx, record + 1, 4);
+        memcpy(&frame.input.mouse_dy, record + 5, 4);
+        memcpy(&frame.player_pos.x, record + 9, 4);
+        memcpy(&frame.player_pos.y, record + 13, 4);
+        memcpy(&frame.player_pos.z, record + 17, 4);
+        memcpy(&frame.state_hash, record + 21, 4);
+    }
+    
+    fclose(replay_file);
+    
+    // Nothing to check, which must not pass for a successful playback
+    if(frames.empty()) {
+        printf("Replay file has no frames:\n%s\n", filepath);
+        return;
+    }
+    
+    loaded = true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common.h"
+#include "game.h"
+
+#define REPLAY_MAGIC   "STCR"
+#define REPLAY_VERSION 1
+
+// Per-frame record: the input fed to Game::Step, and the resulting state
+typedef struct {
+    game_input input;
+    
+    vec3 player_pos;
+    unsigned int state_hash;
+} replay_frame;
+
+//------------------------------------------------------------------------
+// File layout (little-endian):
+//   char[4]  magic "STCR"
+//   uint32   version
+//   uint32   frame count (patched in when the recorder is closed; until
+//            then 0, and Replay counts the frames from the file size)
+//   char[64] terrain directory, char[64] terrain OBJ file
+//   frames, 25 bytes each: buttons (u8), mouse dx/dy (2 x f32),
+//                          player position (3 x f32), state hash (u32)
+//------------------------------------------------------------------------
+class ReplayRecorder {
+public:
+    ReplayRecorder(const char *filepath, const char *terrain_directory, const char *terrain_filename);
+    ~ReplayRecorder();
+    
+    bool IsOpen() const { return file != nullptr; }
+    
+    void RecordFrame(const game_input& input, const Game& game);
+private:
+    FILE *file;
+    unsigned int num_frames;
+};
+
+class Replay {
+public:
+    Replay(const char *filepath);
+    
+    bool IsLoaded() const { return loaded; }
+    
+    char terrain_directory[64];
+    char terrain_filename[64];
+    
+    std::vector<replay_frame> frames;
+private:
+    bool loaded;
+};
@@ -1,4 +1,28 @@
 #include "skybox.h"
+#include "dxt.h"
+#include "texture.h"
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <thread>
+
+// Faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+static const char *cubemap_filenames[] = {
+    "px.bmp",
+    "nx.bmp",
+    "py.bmp",
+    "ny.bmp",
+    "pz.bmp",
+    "nz.bmp",
+};
+
+// Compressed, mipmapped faces are cached next to the source bitmaps
+#define SKYBOX_CACHE_FILENAME "skybox.cache"
+#define SKYBOX_CACHE_MAGIC    "SKYC"
+#define SKYBOX_CACHE_VERSION  1
+
+// Largest face the cache accepts, well beyond any real skybox
+#define SKYBOX_MAX_FACE_SIZE 16384
 
 static const vec3 skybox_vertices[] = {
     { -0.5f, -0.5f,  0.5f },
@@ -20,39 +44,287 @@ static const unsigned int skybox_indices[] = {
     5, 0, 3, 6,
 };
 
-static const char *cubemap_filenames[] = {
-    "data/Skybox/px.bmp",
-    "data/Skybox/nx.bmp",
-    "data/Skybox/py.bmp",
-    "data/Skybox/ny.bmp",
-    "data/Skybox/pz.bmp",
-    "data/Skybox/nz.bmp",
-};
+typedef struct {
+    int64_t mtime;
+    int64_t size;
+} skybox_source_stamp;
+
+typedef struct {
+    unsigned int size;
+    
+    // DXT1 data for each mipmap level, largest first
+    std::vector<std::vector<unsigned char> > levels;
+    
+    // Decoded bitmap, only kept when compression is unavailable
+    Texture *texture;
+} skybox_face;
+
+//------------------------------------------------------------------------------------
+// Name: NumCacheLevels
+// Desc: Mipmap levels of a cached face, down to 1x1, or 0 if the size can't be
+//       cached (not a power of two, or implausibly large)
+//------------------------------------------------------------------------------------
+static unsigned int NumCacheLevels(unsigned int face_size) {
+    if(face_size == 0 || face_size > SKYBOX_MAX_FACE_SIZE || (face_size & (face_size - 1)) != 0)
+        return 0;
+    
+    unsigned int num_levels = 1;
+    
+    while((face_size >> (num_levels - 1)) > 1)
+        num_levels++;
+    
+    return num_levels;
+}
+
+//------------------------------------------------------------------------------------
+// Name: LoadFace
+// Desc: Worker job: decodes one face bitmap and, if compressing, builds its full
+//       mipmap chain and DXT1-compresses every level. Only square power-of-two
+//       faces are compressed; any other leaves no levels. The bitmap is kept until
+//       upload in case another face fails and everything falls back to it
+//------------------------------------------------------------------------------------
+static void LoadFace(skybox_face *face, const char *filepath, bool compress) {
+    Texture *texture = new Texture(filepath);
+    
+    face->size = texture->width;
+    face->texture = texture;
+    
+    if(!compress || texture->data == nullptr || texture->bytes_per_pixel != 3)
+        return;
+    
+    // The mipmap chain halves both sides together, down to 1x1
+    if(texture->width != texture->height || NumCacheLevels(texture->width) == 0)
+        return;
+    
+    std::vector<unsigned char> level(texture->data, texture->data + texture->width * texture->height * 3);
+    unsigned int size = texture->width;
+    
+    while(true) {
+        std::vector<unsigned char> compressed(DXT1Size(size, size));
+        CompressDXT1(level.data(), size, size, compressed.data());
+        face->levels.push_back(compressed);
+        
+        if(size == 1)
+            break;
+        
+        std::vector<unsigned char> next((size / 2) * (size / 2) * 3);
+        DownsampleBGR(level.data(), size, size, next.data());
+        
+        level.swap(next);
+        size /= 2;
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Name: LoadCache
+// Desc: Reads previously compressed faces, if the cache exists and was built from
+//       the same source files. The header must describe a full mipmap chain of a
+//       sane size, exactly filling the rest of the file, or the faces are
+//       compressed again
+//------------------------------------------------------------------------------------
+static bool LoadCache(const char *filepath, const skybox_source_stamp *stamps, skybox_face *faces) {
+    FILE *cache_file = fopen(filepath, "rb");
+    
+    if(!cache_file)
+        return false;
+    
+    char magic[4];
+    uint32_t version, face_size, num_levels;
+    skybox_source_stamp cached_stamps[6];
+    
+    bool valid =
+        fread(magic, 4, 1, cache_file) == 1 && !memcmp(magic, SKYBOX_CACHE_MAGIC, 4) &&
+        fread(&version, 4, 1, cache_file) == 1 && version == SKYBOX_CACHE_VERSION &&
+        fread(&face_size, 4, 1, cache_file) == 1 &&
+        fread(&num_levels, 4, 1, cache_file) == 1 && num_levels > 0 && num_levels == NumCacheLevels(face_size) &&
+        fread(cached_stamps, sizeof(cached_stamps), 1, cache_file) == 1 &&
+        !memcmp(cached_stamps, stamps, sizeof(cached_stamps));
+    
+    if(valid) {
+        long face_bytes = 0;
+        
+        for(unsigned int size = face_size; size > 0; size /= 2)
+            face_bytes += (long)DXT1Size(size, size);
+        
+        long data_start = ftell(cache_file);
+        fseek(cache_file, 0, SEEK_END);
+        
+        valid = ftell(cache_file) - data_start == face_bytes * 6;
+        
+        fseek(cache_file, data_start, SEEK_SET);
+    }
+    
+    for(int i = 0; valid && i < 6; i++) {
+        faces[i].size = face_size;
+        faces[i].levels.resize(num_levels);
+        
+        unsigned int size = face_size;
+        
+        for(unsigned int l = 0; valid && l < num_levels; l++) {
+            faces[i].levels[l].resize(DXT1Size(size, size));
+            valid = fread(faces[i].levels[l].data(), faces[i].levels[l].size(), 1, cache_file) == 1;
+            
+            size = size > 1 ? size / 2 : 1;
+        }
+    }
+    
+    fclose(cache_file);
+    
+    if(!valid) {
+        for(int i = 0; i < 6; i++)
+            faces[i].levels.clear();
+    }
+    
+    return valid;
+}
+
+//------------------------------------------------------------------------------------
+// Name: SaveCache
+// Desc: Writes the compressed faces out for the next run
+//------------------------------------------------------------------------------------
+static void SaveCache(const char *filepath, const skybox_source_stamp *stamps, const skybox_face *faces) {
+    FILE *cache_file = fopen(filepath, "wb");
+    
+    if(!cache_file) {
+        printf("Could not write skybox cache:\n%s\n", filepath);
+        return;
+    }
+    
+    uint32_t version = SKYBOX_CACHE_VERSION;
+    uint32_t face_size = faces[0].size;
+    uint32_t num_levels = (uint32_t)faces[0].levels.size();
+    
+    fwrite(SKYBOX_CACHE_MAGIC, 4, 1, cache_file);
+    fwrite(&version, 4, 1, cache_file);
+    fwrite(&face_size, 4, 1, cache_file);
+    fwrite(&num_levels, 4, 1, cache_file);
+    fwrite(stamps, sizeof(skybox_source_stamp), 6, cache_file);
+    
+    for(int i = 0; i < 6; i++) {
+        for(unsigned int l = 0; l < num_levels; l++)
+            fwrite(faces[i].levels[l].data(), faces[i].levels[l].size(), 1, cache_file);
+    }
+    
+    fclose(cache_file);
+}
 
 //------------------------------------------------------------------------------------
 // Name: Skybox
 // Desc: Constructor for the Skybox class.
-//       Reads a list of hardcoded bitmap image files as one whole cubemap texture
+//       Loads the six px/nx/py/ny/pz/nz bitmaps in a directory as one cubemap.
+//       Faces are decoded and compressed on worker threads, or read back from the
+//       compressed cache of a previous run. Nothing is kept in CPU memory after
+//       the upload
 //------------------------------------------------------------------------------------
-Skybox::Skybox() {
+Skybox::Skybox(const char *directory) {
+    char filepaths[6][256];
+    char cache_filepath[256];
+    skybox_source_stamp stamps[6];
+    
+    memset(stamps, 0, sizeof(stamps));
+    
+    for(int i = 0; i < 6; i++) {
+        strcpy(filepaths[i], directory);
+        strcat(filepaths[i], cubemap_filenames[i]);
+        
+        struct stat source_stat;
+        
+        if(stat(filepaths[i], &source_stat) == 0) {
+            stamps[i].mtime = (int64_t)source_stat.st_mtime;
+            stamps[i].size = (int64_t)source_stat.st_size;
+        }
+    }
+    
+    strcpy(cache_filepath, directory);
+    strcat(cache_filepath, SKYBOX_CACHE_FILENAME);
+    
+    bool compress = GLEW_EXT_texture_compression_s3tc != 0;
+    
+    skybox_face faces[6];
+    
+    for(int i = 0; i < 6; i++) {
+        faces[i].size = 0;
+        faces[i].texture = nullptr;
+    }
+    
+    bool cached = compress && LoadCache(cache_filepath, stamps, faces);
+    
+    if(!cached) {
+        std::thread workers[6];
+        
+        for(int i = 0; i < 6; i++)
+            workers[i] = std::thread(LoadFace, &faces[i], filepaths[i], compress);
+        
+        for(int i = 0; i < 6; i++)
+            workers[i].join();
+        
+        // Fall back to uncompressed faces if any bitmap could not be compressed, or
+        // the faces differ in size and would not make a complete cubemap
+        for(int i = 0; i < 6; i++) {
+            if(faces[i].levels.empty() || faces[i].size != faces[0].size)
+                compress = false;
+        }
+        
+        // Every face now has the same full chain, as LoadCache expects
+        if(compress)
+            SaveCache(cache_filepath, stamps, faces);
+    }
+    
     glGenTextures(1, &cubetex_id);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubetex_id);
     
-    // Load the cube bitmaps from files
     for(int i = 0; i < 6; i++) {
-        cubetex_data[i] = new Texture(cubemap_filenames[i]);
+        if(compress) {
+            unsigned int size = faces[i].size;
+            
+            for(unsigned int l = 0; l < faces[i].levels.size(); l++) {
+                glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, l, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                    size, size, 0, (GLsizei)faces[i].levels[l].size(), faces[i].levels[l].data());
+                
+                size = size > 1 ? size / 2 : 1;
+            }
+        }
+        else if(faces[i].texture != nullptr && faces[i].texture->data != nullptr) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, faces[i].texture->width,
+                faces[i].texture->height, 0, GL_BGR, GL_UNSIGNED_BYTE, faces[i].texture->data);
+        }
         
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, cubetex_data[i]->width,
-            cubetex_data[i]->height, 0, GL_BGR, GL_UNSIGNED_BYTE, cubetex_data[i]->data);
+        // Free the CPU copy as soon as it is uploaded
+        delete faces[i].texture;
+        faces[i].texture = nullptr;
+        faces[i].levels.clear();
     }
     
+    if(!compress)
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     
     glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    
+    // Expand the quads into a triangle list, so the whole cube is one draw call.
+    // Positions double as the cubemap texcoords
+    vec3 triangle_vertices[36];
+    
+    for(int i = 0; i < 6; i++) {
+        const unsigned int *quad = &skybox_indices[i*4];
+        
+        triangle_vertices[i*6]   = skybox_vertices[quad[0]];
+        triangle_vertices[i*6+1] = skybox_vertices[quad[1]];
+        triangle_vertices[i*6+2] = skybox_vertices[quad[2]];
+        triangle_vertices[i*6+3] = skybox_vertices[quad[0]];
+        triangle_vertices[i*6+4] = skybox_vertices[quad[2]];
+        triangle_vertices[i*6+5] = skybox_vertices[quad[3]];
+    }
+    
+    glGenBuffers(1, &vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle_vertices), triangle_vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 //----------------------------------------------------------------
@@ -69,26 +341,18 @@ void Skybox::Draw() {
     
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubetex_id);
     
-    for(int i = 0; i < 6; i++) {
-        const vec3 *p1 = &skybox_vertices[skybox_indices[i*4]];
-        const vec3 *p2 = &skybox_vertices[skybox_indices[i*4+1]];
-        const vec3 *p3 = &skybox_vertices[skybox_indices[i*4+2]];
-        const vec3 *p4 = &skybox_vertices[skybox_indices[i*4+3]];
-        
-        glBegin(GL_QUADS);
-            glTexCoord3f(p1->x, p1->y, p1->z);
-            glVertex3fv(&p1->x);
-            
-            glTexCoord3f(p2->x, p2->y, p2->z);
-            glVertex3fv(&p2->x);
-            
-            glTexCoord3f(p3->x, p3->y, p3->z);
-            glVertex3fv(&p3->x);
-            
-            glTexCoord3f(p4->x, p4->y, p4->z);
-            glVertex3fv(&p4->x);
-        glEnd();
-    }
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    
+    glVertexPointer(3, GL_FLOAT, sizeof(vec3), (void *)0);
+    glTexCoordPointer(3, GL_FLOAT, sizeof(vec3), (void *)0);
+    
+    glDrawArrays(GL_TRIANGLES, 0, GetVertexCount());
+    
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     
     glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
     
@@ -104,8 +368,6 @@ void Skybox::Draw() {
 // Desc: Deconstructor for the Skybox class
 //----------------------------------------------------------------
 Skybox::~Skybox() {
+    glDeleteBuffers(1, &vertex_buffer);
     glDeleteTextures(1, &cubetex_id);
-    
-    for(int i = 0; i < 6; i++)
-        delete cubetex_data[i];
 }
@@ -1,15 +1,19 @@
 #pragma once
 
-#include "main.h"
-#include "texture.h"
+#include "glcommon.h"
 
 class Skybox {
 public:
-    Skybox();
+    Skybox(const char *directory);
     ~Skybox();
     
     void Draw();
+    
+    // For renderers that draw the skybox themselves
+    GLuint GetTexture() const { return cubetex_id; }
+    GLuint GetVertexBuffer() const { return vertex_buffer; }
+    GLsizei GetVertexCount() const { return 36; }
 private:
     GLuint cubetex_id;
-    Texture *cubetex_data[6];
+    GLuint vertex_buffer;
 };
@@ -5,7 +5,22 @@
 // Desc: Constructor for the StaticMesh class.
 //       Employs a very basic OBJ model file importer to load a mesh
 // -----------------------------------------------------------------------------------
-StaticMesh::StaticMesh(const char *directory, const char *filename) {
+StaticMesh::StaticMesh(const char *directory, const char *filename) : StaticMesh(directory, filename, nullptr) {
+}
+
+// -----------------------------------------------------------------------------------
+// Name: StaticMesh
+// Desc: Constructor for the StaticMesh class.
+//       With shared_materials, the mesh uses that mesh's materials and textures
+//       instead of loading its own, and ignores mtllib. It then makes no GL calls,
+//       so it can be loaded on any thread (e.g. the chunks of a ChunkedTerrain)
+// -----------------------------------------------------------------------------------
+StaticMesh::StaticMesh(const char *directory, const char *filename, const StaticMesh *shared_materials) {
+    owns_materials = shared_materials == nullptr;
+    
+    if(shared_materials != nullptr)
+        materials = shared_materials->materials;
+    
     char obj_filepath[256];
     strcpy(obj_filepath, directory);
     strcat(obj_filepath, filename);
@@ -27,7 +42,7 @@ StaticMesh::StaticMesh(const char *directory, const char *filename) {
         sscanf(linebuf, "%s", prefixbuf);
         
         // Parse MTL file
-        if(!strcmp(prefixbuf, "mtllib")) {
+        if(!strcmp(prefixbuf, "mtllib") && owns_materials) {
             char mtl_filepath[256];
             char mtl_filename[128];
             
@@ -99,7 +114,7 @@ StaticMesh::StaticMesh(const char *directory, const char *filename) {
                     glGenTextures(1, &current_material->gl_tex_id);
                     glBindTexture(GL_TEXTURE_2D, current_material->gl_tex_id);
                     
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -282,6 +297,9 @@ void StaticMesh::Draw() {
 }
 
 StaticMesh::~StaticMesh() {
+    if(!owns_materials)
+        return;
+    
     for(unsigned int i = 0; i < materials.size(); i++) {
         if(materials[i].texture != nullptr) {
             glDeleteTextures(1, &materials[i].gl_tex_id);
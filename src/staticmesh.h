@@ -1,6 +1,6 @@
 #pragma once
 
-#include "main.h"
+#include "glcommon.h"
 #include "texture.h"
 
 typedef struct {
@@ -33,6 +33,7 @@ typedef struct {
 class StaticMesh {
 public:
     StaticMesh(const char *directory, const char *filename);
+    StaticMesh(const char *directory, const char *filename, const StaticMesh *shared_materials);
     ~StaticMesh();
     
     void Draw();
@@ -43,4 +44,7 @@ public:
     
     std::vector<static_mesh_material> materials;
     std::vector<static_mesh_group> groups;
+    
+    // False if the materials (and their textures) are borrowed from another mesh
+    bool owns_materials;
 };
@@ -23,6 +23,11 @@ struct bitmap_info_header {
 };
 
 Texture::Texture(const char *filepath) {
+    width = 0;
+    height = 0;
+    bytes_per_pixel = 0;
+    data = nullptr;
+    
     FILE *bmp_file = fopen(filepath, "rb");
     
     if(!bmp_file) {
@@ -46,7 +51,7 @@ Texture::Texture(const char *filepath) {
     
     // Read line-by-line, from bottom to top, as BMPs are stored vertically flipped
     for(unsigned int yline = 0; yline < height; yline++) {
-        fseek(bmp_file, -(yline * pitch) - pitch, SEEK_END);
+        fseek(bmp_file, -(long)((yline + 1) * pitch), SEEK_END);
         fread(data + (yline * pitch), pitch, 1, bmp_file);
     }
     
@@ -54,5 +59,5 @@ Texture::Texture(const char *filepath) {
 }
 
 Texture::~Texture() {
-    delete data;
+    delete[] data;
 }
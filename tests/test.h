@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+
+// Failed checks so far; a test program returns non-zero if there were any
+static unsigned int num_failures = 0;
+
+#define CHECK(condition) \
+    do { if(!(condition)) { printf("FAILED: %s (%s:%d)\n", #condition, __FILE__, __LINE__); num_failures++; } } while(0)
+
+//------------------------------------------------------------------
+// Name: test_result
+// Desc: Reports the outcome of a test program, for its exit code
+//------------------------------------------------------------------
+static int test_result() {
+    if(num_failures > 0) {
+        printf("%u checks FAILED\n", num_failures);
+        return 1;
+    }
+    
+    printf("OK\n");
+    
+    return 0;
+}
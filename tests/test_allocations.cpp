@@ -0,0 +1,172 @@
+#include <cstdlib>
+#include <new>
+
+#include "arena.h"
+#include "collisionmesh.h"
+#include "game.h"
+#include "physicsworld.h"
+#include "playground.h"
+#include "test.h"
+
+// Every heap allocation made by the process, counted by the operators below
+static unsigned long long num_heap_allocations = 0;
+
+void *operator new(size_t size) {
+    num_heap_allocations++;
+    
+    void *p = malloc(size > 0 ? size : 1);
+    
+    if(p == nullptr)
+        throw std::bad_alloc();
+    
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+//------------------------------------------------------------------
+// Name: test_frame_arena
+// Desc: A frame that overflows the arena goes to the heap once, and
+//       the same frame afterwards fits in the grown block
+//------------------------------------------------------------------
+static void test_frame_arena() {
+    FrameArena arena(256);
+    
+    for(int frame = 0; frame < 3; frame++) {
+        arena.Reset();
+        
+        unsigned long long heap_before = num_heap_allocations;
+        
+        ArenaArray<vec3> points;
+        points.Reserve(&arena, 4);
+        
+        for(int i = 0; i < 100; i++)
+            points.push_back(vec3((float)i, 0.0f, 0.0f));
+        
+        int *aligned = arena.Allocate<int>(1);
+        
+        CHECK(points.size() == 100);
+        CHECK(points[99].x == 99.0f);
+        CHECK(((size_t)aligned & (alignof(int) - 1)) == 0);
+        
+        if(frame == 0)
+            CHECK(num_heap_allocations > heap_before);
+        else
+            CHECK(num_heap_allocations == heap_before);
+    }
+    
+    CHECK(arena.num_overflows == 1);
+    CHECK(arena.Capacity() >= arena.peak_bytes);
+}
+
+//------------------------------------------------------------------
+// Name: scripted_input
+// Desc: Walks the player around in a loop, jumping and turning the
+//       camera, with an occasional respawn
+//------------------------------------------------------------------
+static game_input scripted_input(unsigned int frame) {
+    game_input input;
+    input.buttons = 0;
+    input.mouse_dx = 2.0f;
+    input.mouse_dy = (frame / 100) % 2 ? 0.5f : -0.5f;
+    
+    unsigned int phase = (frame / 50) % 4;
+    
+    if(phase == 0)
+        input.buttons |= INPUT_FORWARD;
+    else if(phase == 1)
+        input.buttons |= INPUT_RIGHT;
+    else if(phase == 2)
+        input.buttons |= INPUT_BACK;
+    else
+        input.buttons |= INPUT_LEFT;
+    
+    if(frame % 45 == 0)
+        input.buttons |= INPUT_JUMP;
+    
+    if(frame % 400 == 399)
+        input.buttons |= INPUT_RESPAWN;
+    
+    return input;
+}
+
+//------------------------------------------------------------------
+// Name: test_game_steady_state
+// Desc: Once warmed up, a game frame makes no heap allocations
+//------------------------------------------------------------------
+static void test_game_steady_state(const CollisionMesh *terrain) {
+    Game game(terrain);
+    
+    unsigned int frame = 0;
+    
+    for(; frame < 120; frame++)
+        game.Step(scripted_input(frame));
+    
+    unsigned long long heap_before = num_heap_allocations;
+    
+    for(; frame < 2120; frame++)
+        game.Step(scripted_input(frame));
+    
+    printf("game: %llu heap allocations in 2000 frames, scratch peak %u bytes\n",
+        num_heap_allocations - heap_before, (unsigned int)game.world.scratch.peak_bytes);
+    
+    CHECK(num_heap_allocations == heap_before);
+}
+
+//------------------------------------------------------------------
+// Name: test_world_steady_state
+// Desc: A crowd of bodies piling up on the terrain stops allocating
+//       once the pile has settled
+//------------------------------------------------------------------
+static void test_world_steady_state(const CollisionMesh *terrain) {
+    PhysicsWorld world;
+    
+    vec3 extent = terrain->bounds_max - terrain->bounds_min;
+    
+    for(unsigned int i = 0; i < 256; i++) {
+        float u = ((i % 16) + 0.5f) / 16;
+        float v = ((i / 16) + 0.5f) / 16;
+        
+        world.AddBody(terrain->bounds_min + vec3(extent.x * u, extent.y + 2.0f, extent.z * v), 0.5f, 1.0f);
+    }
+    
+    for(int step = 0; step < 600; step++)
+        world.Step(terrain);
+    
+    unsigned long long heap_before = num_heap_allocations;
+    
+    for(int step = 0; step < 600; step++)
+        world.Step(terrain);
+    
+    printf("world: %llu heap allocations in 600 steps, scratch peak %u bytes, %u arena blocks\n",
+        num_heap_allocations - heap_before, (unsigned int)world.scratch.peak_bytes,
+        world.scratch.num_heap_allocations);
+    
+    CHECK(num_heap_allocations == heap_before);
+    CHECK(world.terrain_contacts.size() == world.num_terrain_contacts);
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Checks that steady-state simulation frames make no heap
+//       allocations. Returns 0 if every check passed, 1 otherwise
+//------------------------------------------------------------------
+int main() {
+    CollisionMesh terrain(playground);
+    
+    test_frame_arena();
+    test_game_steady_state(&terrain);
+    test_world_steady_state(&terrain);
+    
+    return test_result();
+}
@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "chunkedterrain.h"
+#include "collisionmesh.h"
+#include "physicsworld.h"
+#include "playground.h"
+#include "test.h"
+
+// The Playground, cooked by chunkcook with this chunk size
+#define TEST_CHUNK_SIZE 8.0f
+
+typedef struct {
+    float v[9];
+} triangle_key;
+
+static bool operator<(const triangle_key& a, const triangle_key& b) {
+    return std::lexicographical_compare(a.v, a.v + 9, b.v, b.v + 9);
+}
+
+static bool operator==(const triangle_key& a, const triangle_key& b) {
+    return std::equal(a.v, a.v + 9, b.v);
+}
+
+//------------------------------------------------------------------
+// Name: touching_triangles
+// Desc: Appends every triangle of the mesh that really touches the
+//       sphere, by its vertices, since indices differ between meshes
+//------------------------------------------------------------------
+static void touching_triangles(const CollisionMesh *mesh, vec3 P, float r, std::vector<triangle_key>& touching) {
+    const vec3 *tri = mesh->triangles.data();
+    
+    std::vector<unsigned int> candidates;
+    mesh->QuerySphere(P, r, candidates);
+    
+    for(unsigned int c = 0; c < candidates.size(); c++) {
+        unsigned int k = candidates[c];
+        vec3 Q = ClosestPointOnTriangle(P, tri[k*3], tri[k*3+1], tri[k*3+2]);
+        
+        if(dot(P - Q, P - Q) > r * r)
+            continue;
+        
+        triangle_key key;
+        
+        for(int i = 0; i < 3; i++) {
+            key.v[i*3]   = tri[k*3+i].x;
+            key.v[i*3+1] = tri[k*3+i].y;
+            key.v[i*3+2] = tri[k*3+i].z;
+        }
+        
+        touching.push_back(key);
+    }
+}
+
+//------------------------------------------------------------------
+// Name: test_chunk_queries
+// Desc: With every chunk loaded, spheres anywhere (including across
+//       chunk borders) touch the same triangles as in the whole mesh
+//------------------------------------------------------------------
+static void test_chunk_queries(const char *directory, const CollisionMesh *terrain) {
+    ChunkedTerrain chunks(directory, ~(size_t)0, FLT_MAX);
+    
+    vec3 focus(0.0f);
+    chunks.Update(&focus, 1);
+    chunks.WaitForLoads();
+    
+    CHECK(chunks.NumChunks() > 1);
+    CHECK(chunks.resident.size() == chunks.NumChunks());
+    
+    unsigned int num_triangles = 0;
+    
+    for(unsigned int i = 0; i < chunks.resident.size(); i++)
+        num_triangles += chunks.chunks[chunks.resident[i]].mesh->NumTriangles();
+    
+    CHECK(num_triangles == terrain->NumTriangles());
+    
+    FrameArena arena;
+    
+    unsigned int num_mismatches = 0;
+    unsigned int num_straddling = 0;
+    
+    srand(3);
+    
+    for(int query = 0; query < 2000; query++) {
+        // Half the spheres are centred on a chunk border
+        vec3 P(rand() % 320 / 10.0f - 16.0f, rand() % 100 / 10.0f - 3.0f, rand() % 280 / 10.0f - 11.0f);
+        float r = 0.5f + (rand() % 4) * 0.5f;
+        
+        if(query % 2)
+            P.x = roundf(P.x / TEST_CHUNK_SIZE) * TEST_CHUNK_SIZE;
+        
+        std::vector<triangle_key> expected, found;
+        touching_triangles(terrain, P, r, expected);
+        
+        arena.Reset();
+        
+        ArenaArray<const terrain_chunk *> overlapped;
+        overlapped.Reserve(&arena, 4);
+        chunks.QueryChunks(P - vec3(r), P + vec3(r), overlapped);
+        
+        for(unsigned int c = 0; c < overlapped.size(); c++)
+            touching_triangles(overlapped[c]->mesh, P, r, found);
+        
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        
+        if(!(expected.size() == found.size() && std::equal(expected.begin(), expected.end(), found.begin())))
+            num_mismatches++;
+        
+        if(overlapped.size() > 1 && !expected.empty())
+            num_straddling++;
+    }
+    
+    printf("chunks: %u chunks, %u of the queries touching triangles straddled a border\n",
+        chunks.NumChunks(), num_straddling);
+    
+    CHECK(num_mismatches == 0);
+    CHECK(num_straddling > 0);
+    
+    // Rays see the chunks as one terrain too
+    RayHit mesh_hit, chunk_hit;
+    unsigned int num_ray_mismatches = 0;
+    
+    for(int ray = 0; ray < 500; ray++) {
+        vec3 O(rand() % 320 / 10.0f - 16.0f, 12.0f, rand() % 280 / 10.0f - 11.0f);
+        vec3 D = normalize(vec3(rand() % 200 - 100.0f, -100.0f, rand() % 200 - 100.0f));
+        
+        bool mesh_result = terrain->RayCast(mesh_hit, O, D, 100.0f);
+        bool chunk_result = chunks.RayCast(chunk_hit, O, D, 100.0f);
+        
+        if(mesh_result != chunk_result || (mesh_result && fabsf(mesh_hit.t - chunk_hit.t) > 1e-4f))
+            num_ray_mismatches++;
+    }
+    
+    CHECK(num_ray_mismatches == 0);
+}
+
+//------------------------------------------------------------------
+// Name: test_chunk_streaming
+// Desc: Walking the focus across the level keeps the chunks under
+//       it loaded, never goes over the budget, and evicts behind it
+//------------------------------------------------------------------
+static void test_chunk_streaming(const char *directory) {
+    size_t budget = 512 * 1024;
+    float load_radius = 4.0f;
+    
+    ChunkedTerrain chunks(directory, budget, load_radius);
+    
+    unsigned int num_missing = 0;
+    unsigned int num_over_budget = 0;
+    unsigned int num_too_far = 0;
+    
+    for(int step = 0; step <= 64; step++) {
+        vec3 focus(-16.0f + step * 0.5f, 0.0f, -10.0f + step * 0.4f);
+        
+        chunks.Update(&focus, 1);
+        chunks.WaitForLoads();
+        
+        if(chunks.resident_bytes > budget)
+            num_over_budget++;
+        
+        for(unsigned int i = 0; i < chunks.NumChunks(); i++) {
+            const terrain_chunk &chunk = chunks.chunks[i];
+            
+            bool is_under_focus =
+                focus.x >= chunk.bounds_min.x && focus.x <= chunk.bounds_max.x &&
+                focus.z >= chunk.bounds_min.z && focus.z <= chunk.bounds_max.z;
+            
+            if(is_under_focus && chunk.num_bytes <= budget && chunk.state != CHUNK_RESIDENT)
+                num_missing++;
+            
+            if(chunk.state == CHUNK_RESIDENT) {
+                float dx = fmaxf(fmaxf(chunk.bounds_min.x - focus.x, focus.x - chunk.bounds_max.x), 0.0f);
+                float dz = fmaxf(fmaxf(chunk.bounds_min.z - focus.z, focus.z - chunk.bounds_max.z), 0.0f);
+                
+                if(sqrtf(dx * dx + dz * dz) > load_radius + CHUNK_EVICT_MARGIN)
+                    num_too_far++;
+            }
+        }
+    }
+    
+    printf("chunks: %u loads, %u evictions walking across the level\n", chunks.num_loads, chunks.num_evictions);
+    
+    CHECK(num_missing == 0);
+    CHECK(num_over_budget == 0);
+    CHECK(num_too_far == 0);
+    CHECK(chunks.num_evictions > 0);
+    
+    // Destroying the terrain with loads still queued must not hang
+    vec3 far_corner(16.0f, 0.0f, 16.0f);
+    chunks.Update(&far_corner, 1);
+}
+
+//------------------------------------------------------------------
+// Name: test_chunk_physics
+// Desc: Bodies dropped on chunk borders come to rest at the same
+//       height as on the whole mesh. Contacts are resolved in a
+//       different order per chunk, so sliding bodies may drift apart
+//------------------------------------------------------------------
+static void test_chunk_physics(const char *directory, const CollisionMesh *terrain) {
+    ChunkedTerrain chunks(directory, ~(size_t)0, 12.0f);
+    
+    PhysicsWorld mesh_world, chunk_world;
+    
+    for(int i = 0; i < 8; i++) {
+        vec3 pos(i < 4 ? 0.0f : -8.0f + i * 0.5f, 6.0f, i < 4 ? -4.0f + i * 2.5f : 0.0f);
+        
+        mesh_world.AddBody(pos, 0.5f, 1.0f);
+        chunk_world.AddBody(pos, 0.5f, 1.0f);
+    }
+    
+    std::vector<vec3> focus(chunk_world.NumBodies());
+    
+    for(int step = 0; step < 300; step++) {
+        for(unsigned int i = 0; i < chunk_world.NumBodies(); i++)
+            focus[i] = chunk_world.GetPosition(i);
+        
+        chunks.Update(focus.data(), (unsigned int)focus.size());
+        chunks.WaitForLoads();
+        
+        mesh_world.Step(terrain);
+        chunk_world.Step(&chunks);
+    }
+    
+    float max_error = 0.0f;
+    
+    for(unsigned int i = 0; i < mesh_world.NumBodies(); i++)
+        max_error = fmaxf(max_error, fabsf(mesh_world.GetPosition(i).y - chunk_world.GetPosition(i).y));
+    
+    printf("chunks: resting heights within %g of the whole mesh\n", max_error);
+    
+    CHECK(max_error < 1e-3f);
+}
+
+//------------------------------------------------------------------
+// Name: write_file
+// Desc: Writes bytes to a file, replacing it. Returns false if it
+//       could not be written
+//------------------------------------------------------------------
+static bool write_file(const char *filepath, const void *data, size_t size) {
+    FILE *file = fopen(filepath, "wb");
+    
+    if(!file) {
+        printf("Could not write test file:\n%s\n", filepath);
+        return false;
+    }
+    
+    bool written = fwrite(data, 1, size, file) == size;
+    fclose(file);
+    
+    return written;
+}
+
+//------------------------------------------------------------------
+// Name: loads_cooked
+// Desc: Writes a cooked mesh file to the scratch directory and tries
+//       to load it. A mesh that fails to load must be left empty
+//------------------------------------------------------------------
+static bool loads_cooked(const char *scratch, const std::vector<unsigned char>& bytes) {
+    char filepath[320];
+    snprintf(filepath, sizeof(filepath), "%s/corrupt.col", scratch);
+    
+    if(!write_file(filepath, bytes.data(), bytes.size()))
+        return false;
+    
+    CollisionMesh mesh;
+    bool is_loaded = mesh.LoadCooked(filepath);
+    
+    CHECK(is_loaded || (mesh.NumTriangles() == 0 && mesh.nodes.empty()));
+    
+    return is_loaded;
+}
+
+//------------------------------------------------------------------
+// Name: test_corrupt_cooked
+// Desc: A cooked chunk with counts that don't match its length, or a
+//       tree that points outside itself or back up, is rejected
+//------------------------------------------------------------------
+static void test_corrupt_cooked(const char *directory, const char *scratch) {
+    ChunkedTerrain chunks(directory, 0, 0.0f);
+    CHECK(chunks.NumChunks() > 0);
+    
+    if(chunks.NumChunks() == 0)
+        return;
+    
+    // The largest chunk, so its root is an inner node
+    unsigned int largest = 0;
+    
+    for(unsigned int i = 0; i < chunks.NumChunks(); i++) {
+        if(chunks.chunks[i].num_bytes > chunks.chunks[largest].num_bytes)
+            largest = i;
+    }
+    
+    char filepath[320];
+    snprintf(filepath, sizeof(filepath), "%schunk_%d_%d.col", chunks.directory, chunks.chunks[largest].x, chunks.chunks[largest].z);
+    
+    std::vector<unsigned char> cooked;
+    FILE *cooked_file = fopen(filepath, "rb");
+    CHECK(cooked_file != nullptr);
+    
+    if(!cooked_file)
+        return;
+    
+    unsigned char buffer[4096];
+    size_t size;
+    
+    while((size = fread(buffer, 1, sizeof(buffer), cooked_file)) > 0)
+        cooked.insert(cooked.end(), buffer, buffer + size);
+    
+    fclose(cooked_file);
+    
+    // Header: magic, version, triangle and node counts, bounds
+    uint32_t num_triangles, num_nodes;
+    memcpy(&num_triangles, &cooked[8], 4);
+    memcpy(&num_nodes, &cooked[12], 4);
+    
+    size_t nodes_offset = 40 + (size_t)num_triangles * 3 * sizeof(vec3);
+    size_t first_offset = offsetof(collision_bvh_node, first);
+    size_t count_offset = offsetof(collision_bvh_node, count);
+    
+    CHECK(loads_cooked(scratch, cooked));
+    
+    std::vector<unsigned char> bad;
+    uint32_t value;
+    
+    bad.assign(cooked.begin(), cooked.end() - 1);
+    CHECK(!loads_cooked(scratch, bad));
+    
+    bad = cooked;
+    bad.push_back(0);
+    CHECK(!loads_cooked(scratch, bad));
+    
+    // Counts whose sizes wrap around in 32 bits
+    bad = cooked;
+    value = 0x55555556;
+    memcpy(&bad[8], &value, 4);
+    CHECK(!loads_cooked(scratch, bad));
+    
+    bad = cooked;
+    value = 0xFFFFFFFF;
+    memcpy(&bad[12], &value, 4);
+    CHECK(!loads_cooked(scratch, bad));
+    
+    // Root pointing at itself
+    uint32_t root_count;
+    memcpy(&root_count, &cooked[nodes_offset + count_offset], 4);
+    CHECK(root_count == 0);
+    
+    bad = cooked;
+    value = 0;
+    memcpy(&bad[nodes_offset + first_offset], &value, 4);
+    CHECK(!loads_cooked(scratch, bad));
+    
+    // Root whose second child is past the last node
+    bad = cooked;
+    value = num_nodes - 1;
+    memcpy(&bad[nodes_offset + first_offset], &value, 4);
+    CHECK(!loads_cooked(scratch, bad));
+    
+    // Leaf running past the last triangle
+    for(uint32_t i = 0; i < num_nodes; i++) {
+        size_t node_offset = nodes_offset + i * sizeof(collision_bvh_node);
+        uint32_t count;
+        memcpy(&count, &cooked[node_offset + count_offset], 4);
+        
+        if(count == 0)
+            continue;
+        
+        bad = cooked;
+        value = num_triangles - count + 1;
+        memcpy(&bad[node_offset + first_offset], &value, 4);
+        CHECK(!loads_cooked(scratch, bad));
+        break;
+    }
+}
+
+//------------------------------------------------------------------
+// Name: test_chunk_failures
+// Desc: A chunk whose cooked mesh can't be read is marked failed,
+//       gives its bytes back to the budget and is not retried
+//------------------------------------------------------------------
+static void test_chunk_failures(const char *scratch) {
+    char filepath[320];
+    
+    const char index[] = "chunk_size 8\nchunk 0 0 -4 -1 -4 4 1 4 1000\n";
+    snprintf(filepath, sizeof(filepath), "%s/%s", scratch, CHUNK_INDEX_FILENAME);
+    CHECK(write_file(filepath, index, sizeof(index) - 1));
+    
+    const char garbage[] = "STCC not a cooked mesh";
+    snprintf(filepath, sizeof(filepath), "%s/chunk_0_0.col", scratch);
+    CHECK(write_file(filepath, garbage, sizeof(garbage) - 1));
+    
+    ChunkedTerrain chunks(scratch, ~(size_t)0, 8.0f);
+    CHECK(chunks.NumChunks() == 1);
+    
+    vec3 focus(0.0f);
+    
+    for(int update = 0; update < 3; update++) {
+        chunks.Update(&focus, 1);
+        chunks.WaitForLoads();
+    }
+    
+    CHECK(chunks.NumChunks() == 1 && chunks.chunks[0].state == CHUNK_FAILED);
+    CHECK(chunks.resident.empty());
+    CHECK(chunks.resident_bytes == 0);
+    CHECK(chunks.num_loads == 0);
+    CHECK(chunks.num_failed_loads == 1);
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Tests of the terrain chunks cooked into the given directory
+//       by chunkcook, writing broken chunks into an empty scratch
+//       directory. Returns 0 if every check passed, 1 otherwise
+//------------------------------------------------------------------
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        printf("Usage: %s <chunk directory> <scratch directory>\n", argv[0]);
+        return 1;
+    }
+    
+    CollisionMesh terrain(playground);
+    
+    test_chunk_queries(argv[1], &terrain);
+    test_chunk_streaming(argv[1]);
+    test_chunk_physics(argv[1], &terrain);
+    test_corrupt_cooked(argv[1], argv[2]);
+    test_chunk_failures(argv[2]);
+    
+    return test_result();
+}
@@ -0,0 +1,495 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "collision.h"
+#include "collisionmesh.h"
+#include "physicsworld.h"
+#include "playground.h"
+#include "precisionmesh.h"
+#include "single_triangle.h"
+#include "test.h"
+
+//------------------------------------------------------------------
+// Name: test_sphere_triangle
+// Desc: The original sphere-triangle test against a flat, upward
+//       facing triangle
+//------------------------------------------------------------------
+static void test_sphere_triangle(const CollisionMesh& mesh) {
+    const vec3 *tri = mesh.triangles.data();
+    CollisionPacket packet;
+    
+    // Resting half-way into the triangle: pushed straight up by 0.5
+    CHECK(IsIntersectingSphereTriangle(packet, tri[0], tri[1], tri[2], vec3(0.0f, 0.5f, 0.0f), 1.0f));
+    CHECK(fabsf(packet.normal.y - 1.0f) < 1e-6f);
+    CHECK(fabsf(packet.distance + 1.0f - 0.5f) < 1e-6f);
+    
+    // Above it, beside it, and behind it
+    CHECK(!IsIntersectingSphereTriangle(packet, tri[0], tri[1], tri[2], vec3(0.0f, 1.5f, 0.0f), 1.0f));
+    CHECK(!IsIntersectingSphereTriangle(packet, tri[0], tri[1], tri[2], vec3(30.0f, 0.0f, 0.0f), 1.0f));
+    CHECK(!IsIntersectingSphereTriangle(packet, tri[0], tri[1], tri[2], vec3(0.0f, -0.5f, 0.0f), 1.0f));
+    
+    // Touching only the corner at A
+    vec3 outside_a = tri[0] + normalize(tri[0] - (tri[1] + tri[2]) * 0.5f) * 0.9f;
+    CHECK(IsIntersectingSphereTriangle(packet, tri[0], tri[1], tri[2], outside_a, 1.0f));
+}
+
+//------------------------------------------------------------------
+// Name: test_sphere_sphere
+// Desc: Normal and penetration depth of the sphere-sphere test
+//------------------------------------------------------------------
+static void test_sphere_sphere() {
+    CollisionPacket packet;
+    
+    CHECK(IsIntersectingSphereSphere(packet, vec3(1.5f, 0.0f, 0.0f), 1.0f, vec3(0.0f), 1.0f));
+    CHECK(fabsf(packet.normal.x - 1.0f) < 1e-6f);
+    CHECK(fabsf(packet.distance - 0.5f) < 1e-6f);
+    
+    CHECK(!IsIntersectingSphereSphere(packet, vec3(2.5f, 0.0f, 0.0f), 1.0f, vec3(0.0f), 1.0f));
+}
+
+//------------------------------------------------------------------
+// Name: test_single_triangle_queries
+// Desc: Ray, sphere-cast and overlap queries on one triangle
+//------------------------------------------------------------------
+static void test_single_triangle_queries(const CollisionMesh& mesh) {
+    RayHit hit;
+    
+    CHECK(mesh.RayCast(hit, vec3(0.0f, 5.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), 100.0f));
+    CHECK(fabsf(hit.t - 5.0f) < 1e-5f);
+    CHECK(hit.triangle == 0);
+    
+    CHECK(!mesh.RayCast(hit, vec3(0.0f, 5.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), 4.0f));
+    CHECK(!mesh.RayCast(hit, vec3(50.0f, 5.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), 100.0f));
+    CHECK(!mesh.RayCastAny(vec3(0.0f, 5.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), 100.0f));
+    
+    // A sphere of radius 1 dropped from 5 stops when its bottom touches
+    CHECK(mesh.SphereCast(hit, vec3(0.0f, 5.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), 1.0f, 100.0f));
+    CHECK(fabsf(hit.t - 4.0f) < 1e-4f);
+    
+    std::vector<unsigned int> candidates;
+    mesh.QuerySphere(vec3(0.0f, 0.5f, 0.0f), 1.0f, candidates);
+    CHECK(candidates.size() == 1);
+    
+    candidates.clear();
+    mesh.QuerySphere(vec3(0.0f, 5.0f, 0.0f), 1.0f, candidates);
+    CHECK(candidates.empty());
+}
+
+//------------------------------------------------------------------
+// Name: test_bvh_against_brute_force
+// Desc: Random queries on the Playground give the same answers
+//       through the BVH as testing every triangle
+//------------------------------------------------------------------
+static void test_bvh_against_brute_force(const CollisionMesh& mesh) {
+    const vec3 *tri = mesh.triangles.data();
+    const float max_t = 100.0f;
+    
+    unsigned int num_ray_mismatches = 0;
+    unsigned int num_packet_mismatches = 0;
+    unsigned int num_missed_candidates = 0;
+    
+    srand(1);
+    
+    vec3 origins[RAY_PACKET_SIZE];
+    vec3 directions[RAY_PACKET_SIZE];
+    RayHit hits[RAY_PACKET_SIZE];
+    
+    for(int packet = 0; packet < 64; packet++) {
+        for(int i = 0; i < RAY_PACKET_SIZE; i++) {
+            origins[i] = vec3(rand() % 60 - 30.0f, rand() % 30 * 1.0f, rand() % 60 - 30.0f);
+            directions[i] = normalize(vec3(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f) + vec3(0.01f));
+        }
+        
+        mesh.RayCastPacket(hits, origins, directions, max_t, RAY_PACKET_SIZE);
+        
+        for(int i = 0; i < RAY_PACKET_SIZE; i++) {
+            float closest_t = max_t;
+            bool brute_hit = false;
+            
+            for(unsigned int k = 0; k < mesh.NumTriangles(); k++) {
+                float t;
+                
+                if(IsIntersectingRayTriangle(t, origins[i], directions[i], tri[k*3], tri[k*3+1], tri[k*3+2]) && t < closest_t) {
+                    closest_t = t;
+                    brute_hit = true;
+                }
+            }
+            
+            RayHit hit;
+            bool bvh_hit = mesh.RayCast(hit, origins[i], directions[i], max_t);
+            
+            if(bvh_hit != brute_hit || (bvh_hit && fabsf(hit.t - closest_t) > 1e-4f))
+                num_ray_mismatches++;
+            
+            if(mesh.RayCastAny(origins[i], directions[i], max_t) != brute_hit)
+                num_ray_mismatches++;
+            
+            if(hits[i].triangle != hit.triangle || hits[i].t != hit.t)
+                num_packet_mismatches++;
+        }
+    }
+    
+    // Every triangle the sphere really touches must be a candidate
+    for(int query = 0; query < 500; query++) {
+        vec3 P(rand() % 60 - 30.0f, rand() % 20 * 1.0f, rand() % 60 - 30.0f);
+        float r = 0.5f + (rand() % 4) * 0.5f;
+        
+        std::vector<unsigned int> candidates;
+        mesh.QuerySphere(P, r, candidates);
+        
+        std::vector<bool> is_candidate(mesh.NumTriangles(), false);
+        
+        for(unsigned int c = 0; c < candidates.size(); c++)
+            is_candidate[candidates[c]] = true;
+        
+        for(unsigned int k = 0; k < mesh.NumTriangles(); k++) {
+            vec3 Q = ClosestPointOnTriangle(P, tri[k*3], tri[k*3+1], tri[k*3+2]);
+            
+            if(dot(P - Q, P - Q) <= r * r && !is_candidate[k])
+                num_missed_candidates++;
+        }
+    }
+    
+    CHECK(num_ray_mismatches == 0);
+    CHECK(num_packet_mismatches == 0);
+    CHECK(num_missed_candidates == 0);
+}
+
+//------------------------------------------------------------------
+// Name: test_cached_leaves
+// Desc: Spheres inside a box find the same candidates, in the same
+//       order, from the box's leaves as from a full QuerySphere
+//------------------------------------------------------------------
+static void test_cached_leaves(const CollisionMesh& mesh) {
+    FrameArena arena;
+    
+    unsigned int num_mismatches = 0;
+    unsigned int num_candidates = 0;
+    
+    srand(2);
+    
+    for(int query = 0; query < 200; query++) {
+        vec3 center(rand() % 60 - 30.0f, rand() % 20 * 1.0f, rand() % 60 - 30.0f);
+        float r = 0.5f + (rand() % 4) * 0.5f;
+        float margin = 1.0f;
+        
+        std::vector<unsigned int> leaves;
+        mesh.QueryBoxLeaves(center - vec3(r + margin), center + vec3(r + margin), leaves);
+        
+        // Move the sphere around inside the box
+        for(int move = 0; move < 8; move++) {
+            vec3 offset(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f);
+            vec3 P = center + offset * (margin / 100.0f);
+            
+            arena.Reset();
+            
+            ArenaArray<unsigned int> cached;
+            cached.Reserve(&arena, 64);
+            mesh.QuerySphereLeaves(P, r, leaves.data(), (unsigned int)leaves.size(), cached);
+            
+            std::vector<unsigned int> full;
+            mesh.QuerySphere(P, r, full);
+            
+            if(cached.size() != full.size() || !std::equal(full.begin(), full.end(), cached.data()))
+                num_mismatches++;
+            
+            num_candidates += (unsigned int)full.size();
+        }
+    }
+    
+    CHECK(num_mismatches == 0);
+    CHECK(num_candidates > 0);
+}
+
+//------------------------------------------------------------------
+// Name: add_grid
+// Desc: Adds a flat square grid of triangles at height y, facing up
+//       or down, split finely enough to fill several BVH leaves
+//------------------------------------------------------------------
+static void add_grid(CollisionMesh& mesh, float y, bool is_facing_up) {
+    for(int x = -8; x < 8; x++) {
+        for(int z = -8; z < 8; z++) {
+            vec3 A((float)x, y, (float)z);
+            vec3 B((float)x + 1.0f, y, (float)z);
+            vec3 C((float)x, y, (float)z + 1.0f);
+            vec3 D((float)x + 1.0f, y, (float)z + 1.0f);
+            
+            if(is_facing_up) {
+                mesh.AddTriangle(A, C, B);
+                mesh.AddTriangle(B, C, D);
+            } else {
+                mesh.AddTriangle(A, B, C);
+                mesh.AddTriangle(B, D, C);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------
+// Name: test_pushed_body
+// Desc: A body pushed out of the floor into a low ceiling, which was
+//       outside the box it was first queried with, still collides
+//       with the ceiling in the same step
+//------------------------------------------------------------------
+static void test_pushed_body() {
+    CollisionMesh room;
+    add_grid(room, 0.0f, true);
+    add_grid(room, 1.95f, false);
+    room.Build();
+    
+    PhysicsWorld world;
+    world.gravity = 0.0f;
+    world.AddBody(vec3(0.5f, 0.1f, 0.5f), 1.0f, 1.0f);
+    
+    world.Step(&room);
+    
+    bool is_ceiling_hit = false;
+    
+    for(unsigned int c = 0; c < world.terrain_contacts.size(); c++)
+        is_ceiling_hit |= world.terrain_contacts[c].normal.y < -0.5f;
+    
+    CHECK(is_ceiling_hit);
+    CHECK(world.GetPosition(0).y + 1.0f <= 1.95f + 1e-4f);
+}
+
+//------------------------------------------------------------------
+// Name: test_precision_near_origin
+// Desc: Near the origin the float and double kernels find the same
+//       contacts at the same distances, and fixed point nearly so.
+//       Fixed point can disagree on a contact grazing the sphere, and
+//       a small triangle's normal only has 16 fractional bits to be
+//       normalized from, so its distances are only as good as that
+//------------------------------------------------------------------
+static void test_precision_near_origin(const CollisionMesh& mesh, double fixed_tolerance) {
+    glm::dvec3 origin = (glm::dvec3(mesh.bounds_min) + glm::dvec3(mesh.bounds_max)) * 0.5;
+    
+    PrecisionMesh<FloatPrecision> float_mesh(&mesh, origin);
+    PrecisionMesh<DoublePrecision> double_mesh(&mesh, origin);
+    PrecisionMesh<FixedPrecision> fixed_mesh(&mesh, origin);
+    
+    std::vector<BasicCollisionPacket<FloatPrecision> > float_contacts;
+    std::vector<BasicCollisionPacket<DoublePrecision> > double_contacts;
+    std::vector<BasicCollisionPacket<FixedPrecision> > fixed_contacts;
+    
+    unsigned int num_contacts = 0;
+    unsigned int num_double_mismatches = 0;
+    unsigned int num_fixed_mismatches = 0;
+    double max_fixed_error = 0.0;
+    
+    srand(4);
+    
+    for(int query = 0; query < 2000; query++) {
+        // Off the grid the room is built on, so no sphere is exactly tangent to a face
+        glm::dvec3 P(rand() % 600 / 20.0 - 14.99, rand() % 200 / 20.0 - 2.99, rand() % 600 / 20.0 - 14.99);
+        double r = 0.5 + (rand() % 4) * 0.5;
+        
+        float_contacts.clear();
+        double_contacts.clear();
+        fixed_contacts.clear();
+        
+        float_mesh.QuerySphere(float_contacts, float_mesh.ToLocal(P), FloatPrecision::ToScalar(r));
+        double_mesh.QuerySphere(double_contacts, double_mesh.ToLocal(P), DoublePrecision::ToScalar(r));
+        fixed_mesh.QuerySphere(fixed_contacts, fixed_mesh.ToLocal(P), FixedPrecision::ToScalar(r));
+        
+        num_contacts += (unsigned int)double_contacts.size();
+        
+        // The same triangles in the same order, so the contacts line up
+        if(float_contacts.size() != double_contacts.size()) {
+            num_double_mismatches++;
+        } else {
+            for(size_t c = 0; c < double_contacts.size(); c++) {
+                if(fabs(float_contacts[c].distance - double_contacts[c].distance) > 1e-4)
+                    num_double_mismatches++;
+            }
+        }
+        
+        if(fixed_contacts.size() != double_contacts.size()) {
+            num_fixed_mismatches++;
+        } else {
+            for(size_t c = 0; c < double_contacts.size(); c++)
+                max_fixed_error = fmax(max_fixed_error, fabs(fixed_contacts[c].distance.ToDouble() - double_contacts[c].distance));
+        }
+    }
+    
+    CHECK(num_contacts > 0);
+    CHECK(num_double_mismatches == 0);
+    CHECK(num_fixed_mismatches <= 20);
+    CHECK(max_fixed_error <= fixed_tolerance);
+}
+
+//------------------------------------------------------------------
+// Name: test_precision_far_from_origin
+// Desc: Ten million units from the origin, where floats are a whole
+//       unit apart, the float path misses a sphere 0.05 into a floor.
+//       The double and fixed-point meshes, built from the double
+//       precision triangles, still find it
+//------------------------------------------------------------------
+static void test_precision_far_from_origin() {
+    glm::dvec3 far(1e7, 1e7, 1e7);
+    
+    std::vector<glm::dvec3> floor;
+    CollisionMesh float_floor;
+    
+    for(int x = -4; x < 4; x++) {
+        for(int z = -4; z < 4; z++) {
+            glm::dvec3 A = far + glm::dvec3(x, 0.4, z);
+            glm::dvec3 B = far + glm::dvec3(x + 1, 0.4, z);
+            glm::dvec3 C = far + glm::dvec3(x, 0.4, z + 1);
+            glm::dvec3 D = far + glm::dvec3(x + 1, 0.4, z + 1);
+            
+            glm::dvec3 tris[6] = { A, C, B, B, C, D };
+            
+            for(int k = 0; k < 6; k += 3) {
+                floor.push_back(tris[k]);
+                floor.push_back(tris[k+1]);
+                floor.push_back(tris[k+2]);
+                float_floor.AddTriangle(vec3(tris[k]), vec3(tris[k+1]), vec3(tris[k+2]));
+            }
+        }
+    }
+    
+    float_floor.Build();
+    
+    glm::dvec3 P = far + glm::dvec3(0.25, 0.65, 0.25);
+    double r = 0.3;
+    
+    // The float path, as the game runs it
+    std::vector<unsigned int> candidates;
+    float_floor.QuerySphere(vec3(P), (float)r, candidates);
+    
+    unsigned int num_float_contacts = 0;
+    
+    for(size_t c = 0; c < candidates.size(); c++) {
+        const vec3 *tri = &float_floor.triangles[candidates[c] * 3];
+        CollisionPacket packet;
+        
+        num_float_contacts += IsIntersectingSphereTriangle(packet, tri[0], tri[1], tri[2], vec3(P), (float)r);
+    }
+    
+    // Double without an origin still rounds the BVH to whole units, which the padding covers
+    PrecisionMesh<DoublePrecision> double_world(floor);
+    PrecisionMesh<DoublePrecision> double_local(floor, far);
+    PrecisionMesh<FixedPrecision> fixed_local(floor, far);
+    
+    std::vector<BasicCollisionPacket<DoublePrecision> > double_world_contacts, double_local_contacts;
+    std::vector<BasicCollisionPacket<FixedPrecision> > fixed_contacts;
+    
+    double_world.QuerySphere(double_world_contacts, double_world.ToLocal(P), r);
+    double_local.QuerySphere(double_local_contacts, double_local.ToLocal(P), r);
+    fixed_local.QuerySphere(fixed_contacts, fixed_local.ToLocal(P), FixedPrecision::ToScalar(r));
+    
+    CHECK(num_float_contacts == 0);
+    CHECK(!double_world_contacts.empty());
+    CHECK(!double_local_contacts.empty());
+    CHECK(!fixed_contacts.empty());
+    
+    for(size_t c = 0; c < fixed_contacts.size(); c++)
+        CHECK(fabs(fixed_contacts[c].distance.ToDouble() + r - 0.05) < 1e-3);
+}
+
+//------------------------------------------------------------------
+// Name: test_fixed_degenerate
+// Desc: Degenerate triangles give no contact in fixed point, rather
+//       than dividing by zero
+//------------------------------------------------------------------
+static void test_fixed_degenerate() {
+    BasicCollisionPacket<FixedPrecision> packet;
+    
+    FixedVec3 A(Fixed(0), Fixed(0), Fixed(0));
+    FixedVec3 B(Fixed(1), Fixed(0), Fixed(0));
+    FixedVec3 C(Fixed(2), Fixed(0), Fixed(0));
+    FixedVec3 tiny(Fixed::FromRaw(1), Fixed(0), Fixed::FromRaw(1));
+    
+    CHECK(!IsIntersectingSphereTriangleT<FixedPrecision>(packet, A, B, C, A, Fixed(1)));
+    CHECK(!IsIntersectingSphereTriangleT<FixedPrecision>(packet, A, A, A, A, Fixed(1)));
+    CHECK(!IsIntersectingSphereTriangleT<FixedPrecision>(packet, A, B, tiny, A, Fixed(1)));
+    
+    CHECK((Fixed(1) / Fixed()).raw == INT64_MAX);
+}
+
+//------------------------------------------------------------------
+// Name: test_fixed_range
+// Desc: Fixed point saturates instead of wrapping, agrees with double
+//       on triangles as large as it allows, and a fixed-point mesh
+//       leaves out triangles larger than that
+//------------------------------------------------------------------
+static void test_fixed_range() {
+    CHECK((Fixed(1e8) * Fixed(1e8)).raw == INT64_MAX);
+    CHECK((Fixed(-1e8) * Fixed(1e8)).raw == INT64_MIN);
+    CHECK((Fixed::FromRaw(INT64_MAX) + Fixed(1)).raw == INT64_MAX);
+    CHECK((Fixed::FromRaw(INT64_MIN) - Fixed(1)).raw == INT64_MIN);
+    
+    FixedVec3 huge(Fixed(1e6), Fixed(1e6), Fixed(1e6));
+    CHECK(dot(huge, huge) > Fixed(0));
+    
+    // Facing up, with every edge as long as fixed point allows
+    double edge = FIXED_MAX_TRIANGLE_EDGE;
+    glm::dvec3 A(-edge / 2, 0.0, 0.0);
+    glm::dvec3 B(0.0, 0.0, edge * sqrt(3.0) / 2);
+    glm::dvec3 C(edge / 2, 0.0, 0.0);
+    
+    // Touching edge AC, just past it, and over the middle
+    glm::dvec3 spheres[3] = { glm::dvec3(0.0, 0.3, -0.2), glm::dvec3(0.0, 0.3, -0.6), glm::dvec3(0.0, 0.3, 20.0) };
+    double r = 0.5;
+    
+    for(int i = 0; i < 3; i++) {
+        BasicCollisionPacket<DoublePrecision> double_packet = {};
+        BasicCollisionPacket<FixedPrecision> fixed_packet = {};
+        
+        bool double_result = IsIntersectingSphereTriangleT<DoublePrecision>(double_packet, A, B, C, spheres[i], r);
+        bool fixed_result = IsIntersectingSphereTriangleT<FixedPrecision>(fixed_packet,
+            FixedPrecision::ToVector(A), FixedPrecision::ToVector(B), FixedPrecision::ToVector(C),
+            FixedPrecision::ToVector(spheres[i]), FixedPrecision::ToScalar(r));
+        
+        CHECK(double_result == (i != 1));
+        CHECK(fixed_result == double_result);
+        
+        if(fixed_result && double_result)
+            CHECK(fabs(fixed_packet.distance.ToDouble() - double_packet.distance) < 1e-3);
+    }
+    
+    // A triangle four times larger has no place in a fixed-point mesh
+    std::vector<glm::dvec3> triangles;
+    triangles.push_back(A * 4.0);
+    triangles.push_back(B * 4.0);
+    triangles.push_back(C * 4.0);
+    triangles.push_back(A);
+    triangles.push_back(B);
+    triangles.push_back(C);
+    
+    PrecisionMesh<FixedPrecision> fixed_mesh(triangles);
+    PrecisionMesh<DoublePrecision> double_mesh(triangles);
+    
+    CHECK(fixed_mesh.num_rejected == 1 && fixed_mesh.triangles.size() == 3);
+    CHECK(double_mesh.num_rejected == 0 && double_mesh.triangles.size() == 6);
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Unit tests of the collision tests and mesh queries.
+//       Returns 0 if every check passed, 1 otherwise
+//------------------------------------------------------------------
+int main() {
+    CollisionMesh triangle(single_triangle);
+    CollisionMesh terrain(playground);
+    
+    test_sphere_triangle(triangle);
+    test_sphere_sphere();
+    test_single_triangle_queries(triangle);
+    test_bvh_against_brute_force(terrain);
+    test_cached_leaves(terrain);
+    test_pushed_body();
+    test_precision_near_origin(terrain, 0.15);
+    
+    CollisionMesh room;
+    add_grid(room, 0.0f, true);
+    add_grid(room, 1.95f, false);
+    room.Build();
+    
+    test_precision_near_origin(room, 1e-3);
+    test_precision_far_from_origin();
+    test_fixed_degenerate();
+    test_fixed_range();
+    
+    return test_result();
+}
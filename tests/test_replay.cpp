@@ -0,0 +1,189 @@
+#include <stdint.h>
+
+#include "collisionmesh.h"
+#include "game.h"
+#include "playground.h"
+#include "replay.h"
+#include "test.h"
+
+// Offsets in the replay file, as laid out in replay.h
+#define TEST_REPLAY_COUNT_OFFSET 8
+#define TEST_REPLAY_HEADER_SIZE  (4 + 4 + 4 + 64 + 64)
+#define TEST_REPLAY_FRAME_SIZE   25
+
+#define TEST_REPLAY_FRAMES 120
+
+//------------------------------------------------------------------
+// Name: scripted_input
+// Desc: Input for a frame of the recorded session: walking forward
+//       while turning, with a jump now and then
+//------------------------------------------------------------------
+static game_input scripted_input(unsigned int frame) {
+    game_input input;
+    input.buttons = INPUT_FORWARD;
+    input.mouse_dx = frame < 60 ? 2.0f : -1.5f;
+    input.mouse_dy = 0.0f;
+    
+    if(frame % 40 == 20)
+        input.buttons |= INPUT_JUMP;
+    
+    return input;
+}
+
+//------------------------------------------------------------------
+// Name: read_file
+// Desc: Reads a whole file into bytes, empty if it can't be opened
+//------------------------------------------------------------------
+static std::vector<unsigned char> read_file(const char *filepath) {
+    std::vector<unsigned char> bytes;
+    FILE *file = fopen(filepath, "rb");
+    
+    if(!file)
+        return bytes;
+    
+    unsigned char buffer[4096];
+    size_t size;
+    
+    while((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + size);
+    
+    fclose(file);
+    
+    return bytes;
+}
+
+//------------------------------------------------------------------
+// Name: write_file
+// Desc: Writes bytes to a file, replacing it
+//------------------------------------------------------------------
+static void write_file(const char *filepath, const std::vector<unsigned char>& bytes) {
+    FILE *file = fopen(filepath, "wb");
+    
+    if(!file) {
+        printf("Could not write test file:\n%s\n", filepath);
+        return;
+    }
+    
+    fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+}
+
+//------------------------------------------------------------------
+// Name: num_matching_frames
+// Desc: Re-simulates a replay as tools/playback does, returning how
+//       many frames match the recording before the first divergence
+//------------------------------------------------------------------
+static unsigned int num_matching_frames(const Replay& replay, const CollisionMesh *terrain) {
+    Game game(terrain);
+    
+    for(unsigned int i = 0; i < replay.frames.size(); i++) {
+        game.Step(replay.frames[i].input);
+        
+        if(game.player_pos != replay.frames[i].player_pos || game.StateHash() != replay.frames[i].state_hash)
+            return i;
+    }
+    
+    return (unsigned int)replay.frames.size();
+}
+
+//------------------------------------------------------------------
+// Name: loaded_frames
+// Desc: Writes a variant of the recording and loads it, returning the
+//       number of frames it plays back correctly, or -1 if rejected
+//------------------------------------------------------------------
+static int loaded_frames(const char *filepath, const std::vector<unsigned char>& bytes, const CollisionMesh *terrain) {
+    write_file(filepath, bytes);
+    
+    Replay replay(filepath);
+    
+    if(!replay.IsLoaded())
+        return -1;
+    
+    return (int)num_matching_frames(replay, terrain);
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Records a short session into the given file, then checks
+//       that playback reads it back frame for frame, and that damaged
+//       copies are played as far as they go or rejected when there is
+//       nothing to play. Returns 0 if every check passed, 1 otherwise
+//------------------------------------------------------------------
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("Usage: %s <scratch replay file>\n", argv[0]);
+        return 1;
+    }
+    
+    const char *filepath = argv[1];
+    CollisionMesh terrain(playground);
+    
+    {
+        ReplayRecorder recorder(filepath, "data/Playground/", "Playground.obj");
+        CHECK(recorder.IsOpen());
+        
+        Game game(&terrain);
+        
+        for(unsigned int i = 0; i < TEST_REPLAY_FRAMES; i++) {
+            game_input input = scripted_input(i);
+            game.Step(input);
+            recorder.RecordFrame(input, game);
+        }
+    }
+    
+    std::vector<unsigned char> recorded = read_file(filepath);
+    CHECK(recorded.size() == TEST_REPLAY_HEADER_SIZE + TEST_REPLAY_FRAMES * TEST_REPLAY_FRAME_SIZE);
+    
+    if(recorded.size() != TEST_REPLAY_HEADER_SIZE + TEST_REPLAY_FRAMES * TEST_REPLAY_FRAME_SIZE)
+        return test_result();
+    
+    CHECK(loaded_frames(filepath, recorded, &terrain) == TEST_REPLAY_FRAMES);
+    
+    std::vector<unsigned char> damaged;
+    uint32_t count;
+    
+    // A recording that was never closed still has a count of 0, and one
+    // that undercounts is read to the end of the file
+    damaged = recorded;
+    count = 0;
+    memcpy(&damaged[TEST_REPLAY_COUNT_OFFSET], &count, 4);
+    CHECK(loaded_frames(filepath, damaged, &terrain) == TEST_REPLAY_FRAMES);
+    
+    damaged = recorded;
+    count = 50;
+    memcpy(&damaged[TEST_REPLAY_COUNT_OFFSET], &count, 4);
+    CHECK(loaded_frames(filepath, damaged, &terrain) == TEST_REPLAY_FRAMES);
+    
+    // Overcounted, or cut off partway through a frame: the whole frames play
+    damaged = recorded;
+    count = 0xFFFFFFFF;
+    memcpy(&damaged[TEST_REPLAY_COUNT_OFFSET], &count, 4);
+    CHECK(loaded_frames(filepath, damaged, &terrain) == TEST_REPLAY_FRAMES);
+    
+    damaged.assign(recorded.begin(), recorded.begin() + TEST_REPLAY_HEADER_SIZE + 60 * TEST_REPLAY_FRAME_SIZE + 10);
+    CHECK(loaded_frames(filepath, damaged, &terrain) == 60);
+    
+    damaged[TEST_REPLAY_COUNT_OFFSET] = 0;
+    damaged[TEST_REPLAY_COUNT_OFFSET + 1] = 0;
+    damaged[TEST_REPLAY_COUNT_OFFSET + 2] = 0;
+    damaged[TEST_REPLAY_COUNT_OFFSET + 3] = 0;
+    CHECK(loaded_frames(filepath, damaged, &terrain) == 60);
+    
+    // Nothing to play back is rejected, whatever the header says
+    damaged.assign(recorded.begin(), recorded.begin() + TEST_REPLAY_HEADER_SIZE);
+    CHECK(loaded_frames(filepath, damaged, &terrain) == -1);
+    
+    count = 0;
+    memcpy(&damaged[TEST_REPLAY_COUNT_OFFSET], &count, 4);
+    CHECK(loaded_frames(filepath, damaged, &terrain) == -1);
+    
+    damaged.resize(TEST_REPLAY_HEADER_SIZE + TEST_REPLAY_FRAME_SIZE - 1);
+    CHECK(loaded_frames(filepath, damaged, &terrain) == -1);
+    
+    // A corrupted frame stops playback there
+    damaged = recorded;
+    damaged[TEST_REPLAY_HEADER_SIZE + 30 * TEST_REPLAY_FRAME_SIZE + 13] ^= 0x40;
+    CHECK(loaded_frames(filepath, damaged, &terrain) == 30);
+    
+    return test_result();
+}
@@ -0,0 +1,425 @@
+#include <map>
+#include <string>
+#include <sys/stat.h>
+
+#include "chunkedterrain.h"
+#include "collisionmesh.h"
+
+typedef struct {
+    unsigned int vertex_index[3];
+    unsigned int uv_index[3];
+    unsigned int normal_index[3];
+    
+    unsigned int group;
+    unsigned int material;
+} cook_face;
+
+typedef struct {
+    std::vector<vec3> vertices;
+    std::vector<vec2> uvs;
+    std::vector<vec3> normals;
+    
+    std::vector<std::string> groups;
+    std::vector<std::string> materials;
+    
+    std::vector<cook_face> faces;
+    
+    char mtl_filename[128];
+} cook_model;
+
+//------------------------------------------------------------------
+// Name: find_or_add
+// Desc: Index of a name in a list, adding it if it is new
+//------------------------------------------------------------------
+static unsigned int find_or_add(std::vector<std::string>& names, const char *name) {
+    for(unsigned int i = 0; i < names.size(); i++) {
+        if(names[i] == name)
+            return i;
+    }
+    
+    names.push_back(name);
+    return (unsigned int)names.size() - 1;
+}
+
+//------------------------------------------------------------------
+// Name: load_model
+// Desc: Reads everything StaticMesh and CollisionMesh use from an
+//       OBJ file: positions, texcoords, normals, groups, materials
+//       and v/vt/vn faces
+//------------------------------------------------------------------
+static bool load_model(cook_model& model, const char *directory, const char *filename) {
+    char obj_filepath[256];
+    snprintf(obj_filepath, sizeof(obj_filepath), "%s%s", directory, filename);
+    
+    FILE *obj_file = fopen(obj_filepath, "r");
+    
+    if(!obj_file) {
+        printf("Could not open OBJ file:\n%s\n", obj_filepath);
+        return false;
+    }
+    
+    char linebuf[256];
+    unsigned int group = find_or_add(model.groups, "default");
+    unsigned int material = 0;
+    
+    model.mtl_filename[0] = '\0';
+    
+    while(fgets(linebuf, sizeof(linebuf), obj_file) != nullptr) {
+        char prefixbuf[32];
+        char name[128];
+        
+        if(sscanf(linebuf, "%31s", prefixbuf) != 1)
+            continue;
+        
+        if(!strcmp(prefixbuf, "mtllib")) {
+            sscanf(linebuf, "%s %127s", prefixbuf, model.mtl_filename);
+        }
+        else if(!strcmp(prefixbuf, "g") && sscanf(linebuf, "%s %127s", prefixbuf, name) == 2) {
+            group = find_or_add(model.groups, name);
+        }
+        else if(!strcmp(prefixbuf, "usemtl") && sscanf(linebuf, "%s %127s", prefixbuf, name) == 2) {
+            material = find_or_add(model.materials, name);
+        }
+        else if(!strcmp(prefixbuf, "v")) {
+            vec3 vertex;
+            sscanf(linebuf, "%s %f %f %f", prefixbuf, &vertex.x, &vertex.y, &vertex.z);
+            model.vertices.push_back(vertex);
+        }
+        else if(!strcmp(prefixbuf, "vt")) {
+            vec2 uv;
+            sscanf(linebuf, "%s %f %f", prefixbuf, &uv.x, &uv.y);
+            model.uvs.push_back(uv);
+        }
+        else if(!strcmp(prefixbuf, "vn")) {
+            vec3 normal;
+            sscanf(linebuf, "%s %f %f %f", prefixbuf, &normal.x, &normal.y, &normal.z);
+            model.normals.push_back(normal);
+        }
+        else if(!strcmp(prefixbuf, "f")) {
+            cook_face face;
+            
+            int fields = sscanf(linebuf, "%s %u/%u/%u %u/%u/%u %u/%u/%u", prefixbuf,
+                &face.vertex_index[0], &face.uv_index[0], &face.normal_index[0],
+                &face.vertex_index[1], &face.uv_index[1], &face.normal_index[1],
+                &face.vertex_index[2], &face.uv_index[2], &face.normal_index[2]
+                );
+            
+            if(fields != 10) {
+                printf("Skipping face without v/vt/vn indices:\n%s", linebuf);
+                continue;
+            }
+            
+            bool is_valid = true;
+            
+            // Face indices start at 1, so we adjust accordingly
+            for(int i = 0; i < 3; i++) {
+                face.vertex_index[i]--;
+                face.uv_index[i]--;
+                face.normal_index[i]--;
+                
+                is_valid = is_valid && face.vertex_index[i] < model.vertices.size() &&
+                    face.uv_index[i] < model.uvs.size() && face.normal_index[i] < model.normals.size();
+            }
+            
+            if(!is_valid)
+                continue;
+            
+            face.group = group;
+            face.material = material;
+            
+            model.faces.push_back(face);
+        }
+    }
+    
+    fclose(obj_file);
+    
+    if(model.materials.empty())
+        model.materials.push_back("default");
+    
+    return true;
+}
+
+//------------------------------------------------------------------
+// Name: copy_file
+// Desc: Copies a file byte for byte
+//------------------------------------------------------------------
+static bool copy_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    
+    if(!in) {
+        printf("Could not open file:\n%s\n", from);
+        return false;
+    }
+    
+    FILE *out = fopen(to, "wb");
+    
+    if(!out) {
+        printf("Could not open output file:\n%s\n", to);
+        fclose(in);
+        return false;
+    }
+    
+    char buf[4096];
+    size_t size;
+    
+    while((size = fread(buf, 1, sizeof(buf), in)) > 0)
+        fwrite(buf, 1, size, out);
+    
+    fclose(in);
+    fclose(out);
+    
+    return true;
+}
+
+//------------------------------------------------------------------
+// Name: copy_materials
+// Desc: Copies the MTL file and the textures it names next to the
+//       chunks, and writes materials.obj, which only loads them, so
+//       the chunk directory stands alone and the chunks can share
+//       one set of materials
+//------------------------------------------------------------------
+static bool copy_materials(const cook_model& model, const char *directory, const char *out_directory) {
+    char from[512], to[512];
+    
+    snprintf(to, sizeof(to), "%smaterials.obj", out_directory);
+    
+    FILE *materials_file = fopen(to, "w");
+    
+    if(!materials_file) {
+        printf("Could not open output file:\n%s\n", to);
+        return false;
+    }
+    
+    if(model.mtl_filename[0] != '\0')
+        fprintf(materials_file, "mtllib %s\n", model.mtl_filename);
+    
+    fclose(materials_file);
+    
+    if(model.mtl_filename[0] == '\0')
+        return true;
+    
+    snprintf(from, sizeof(from), "%s%s", directory, model.mtl_filename);
+    snprintf(to, sizeof(to), "%s%s", out_directory, model.mtl_filename);
+    
+    if(!copy_file(from, to))
+        return false;
+    
+    FILE *mtl_file = fopen(from, "r");
+    char linebuf[256];
+    
+    while(fgets(linebuf, sizeof(linebuf), mtl_file) != nullptr) {
+        char prefixbuf[32];
+        char texture_filename[128];
+        
+        if(sscanf(linebuf, "%31s %127s", prefixbuf, texture_filename) != 2 || strcmp(prefixbuf, "map_Kd"))
+            continue;
+        
+        snprintf(from, sizeof(from), "%s%s", directory, texture_filename);
+        snprintf(to, sizeof(to), "%s%s", out_directory, texture_filename);
+        
+        copy_file(from, to);
+    }
+    
+    fclose(mtl_file);
+    
+    return true;
+}
+
+//------------------------------------------------------------------
+// Name: write_render_chunk
+// Desc: Writes a chunk's faces as an OBJ file for StaticMesh, with
+//       only the vertices they use. Groups and materials are named
+//       as in the source, but the file has no mtllib: the chunks
+//       share the materials loaded from materials.obj
+//------------------------------------------------------------------
+static bool write_render_chunk(const cook_model& model, const std::vector<unsigned int>& faces, const char *filepath) {
+    FILE *out = fopen(filepath, "w");
+    
+    if(!out) {
+        printf("Could not open output file:\n%s\n", filepath);
+        return false;
+    }
+    
+    // New index (from 1) of each source vertex used, 0 if unused
+    std::vector<unsigned int> vertex_remap(model.vertices.size(), 0);
+    std::vector<unsigned int> uv_remap(model.uvs.size(), 0);
+    std::vector<unsigned int> normal_remap(model.normals.size(), 0);
+    
+    unsigned int num_vertices = 0, num_uvs = 0, num_normals = 0;
+    
+    // StaticMesh reuses the last prefix on a blank line, so never write one
+    fprintf(out, "# Generated by chunkcook. Do not edit\n");
+    
+    for(unsigned int f = 0; f < faces.size(); f++) {
+        const cook_face &face = model.faces[faces[f]];
+        
+        for(int i = 0; i < 3; i++) {
+            if(vertex_remap[face.vertex_index[i]] == 0) {
+                vec3 v = model.vertices[face.vertex_index[i]];
+                fprintf(out, "v %.9g %.9g %.9g\n", v.x, v.y, v.z);
+                vertex_remap[face.vertex_index[i]] = ++num_vertices;
+            }
+            
+            if(uv_remap[face.uv_index[i]] == 0) {
+                vec2 uv = model.uvs[face.uv_index[i]];
+                fprintf(out, "vt %.9g %.9g\n", uv.x, uv.y);
+                uv_remap[face.uv_index[i]] = ++num_uvs;
+            }
+            
+            if(normal_remap[face.normal_index[i]] == 0) {
+                vec3 n = model.normals[face.normal_index[i]];
+                fprintf(out, "vn %.9g %.9g %.9g\n", n.x, n.y, n.z);
+                normal_remap[face.normal_index[i]] = ++num_normals;
+            }
+        }
+    }
+    
+    unsigned int group = ~0u, material = ~0u;
+    
+    for(unsigned int f = 0; f < faces.size(); f++) {
+        const cook_face &face = model.faces[faces[f]];
+        
+        // StaticMesh keeps one submesh per group and material, so restate the
+        // material whenever the group changes
+        if(face.group != group) {
+            group = face.group;
+            material = ~0u;
+            fprintf(out, "g %s\n", model.groups[group].c_str());
+        }
+        
+        if(face.material != material) {
+            material = face.material;
+            fprintf(out, "usemtl %s\n", model.materials[material].c_str());
+        }
+        
+        fprintf(out, "f %u/%u/%u %u/%u/%u %u/%u/%u\n",
+            vertex_remap[face.vertex_index[0]], uv_remap[face.uv_index[0]], normal_remap[face.normal_index[0]],
+            vertex_remap[face.vertex_index[1]], uv_remap[face.uv_index[1]], normal_remap[face.normal_index[1]],
+            vertex_remap[face.vertex_index[2]], uv_remap[face.uv_index[2]], normal_remap[face.normal_index[2]]
+            );
+    }
+    
+    fclose(out);
+    
+    return true;
+}
+
+static unsigned int file_size(const char *filepath) {
+    struct stat info;
+    
+    return stat(filepath, &info) == 0 ? (unsigned int)info.st_size : 0;
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Cooks an OBJ model into terrain chunks for ChunkedTerrain.
+//       Each triangle goes to the square chunk_size cell (on X and
+//       Z, from the world origin) holding its centroid. For every
+//       non-empty cell it writes chunk_<x>_<z>.obj to render and
+//       chunk_<x>_<z>.col, the cooked collision mesh with its BVH.
+//       chunks.txt indexes them with their bounds and sizes.
+//
+//       Usage: chunkcook <directory> <file> <chunk size> <output directory>
+//------------------------------------------------------------------
+int main(int argc, char **argv) {
+    if(argc < 5) {
+        printf("Usage: %s <directory> <file> <chunk size> <output directory>\n", argv[0]);
+        return -1;
+    }
+    
+    const char *directory = argv[1];
+    const char *out_directory = argv[4];
+    float chunk_size = (float)atof(argv[3]);
+    
+    if(chunk_size <= 0.0f) {
+        printf("Chunk size must be positive\n");
+        return -1;
+    }
+    
+    cook_model model;
+    
+    if(!load_model(model, directory, argv[2]) || model.faces.empty())
+        return -1;
+    
+    // Faces of each cell, in source order
+    std::map<std::pair<int, int>, std::vector<unsigned int> > cells;
+    
+    for(unsigned int f = 0; f < model.faces.size(); f++) {
+        const cook_face &face = model.faces[f];
+        
+        vec3 centroid = (model.vertices[face.vertex_index[0]] +
+            model.vertices[face.vertex_index[1]] +
+            model.vertices[face.vertex_index[2]]) / 3.0f;
+        
+        int x = (int)floorf(centroid.x / chunk_size);
+        int z = (int)floorf(centroid.z / chunk_size);
+        
+        cells[std::make_pair(x, z)].push_back(f);
+    }
+    
+    if(!copy_materials(model, directory, out_directory))
+        return -1;
+    
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s%s", out_directory, CHUNK_INDEX_FILENAME);
+    
+    FILE *index_file = fopen(filepath, "w");
+    
+    if(!index_file) {
+        printf("Could not open output file:\n%s\n", filepath);
+        return -1;
+    }
+    
+    fprintf(index_file, "# Generated by chunkcook from %s%s. Do not edit\n", directory, argv[2]);
+    fprintf(index_file, "chunk_size %.9g\n", chunk_size);
+    
+    unsigned int total_bytes = 0;
+    
+    for(std::map<std::pair<int, int>, std::vector<unsigned int> >::iterator it = cells.begin(); it != cells.end(); ++it) {
+        int x = it->first.first;
+        int z = it->first.second;
+        const std::vector<unsigned int> &faces = it->second;
+        
+        CollisionMesh mesh;
+        
+        for(unsigned int f = 0; f < faces.size(); f++) {
+            const cook_face &face = model.faces[faces[f]];
+            
+            mesh.AddTriangle(
+                model.vertices[face.vertex_index[0]],
+                model.vertices[face.vertex_index[1]],
+                model.vertices[face.vertex_index[2]]
+                );
+        }
+        
+        mesh.Build();
+        
+        snprintf(filepath, sizeof(filepath), "%schunk_%d_%d.col", out_directory, x, z);
+        
+        if(!mesh.SaveCooked(filepath))
+            return -1;
+        
+        unsigned int num_bytes = file_size(filepath);
+        
+        snprintf(filepath, sizeof(filepath), "%schunk_%d_%d.obj", out_directory, x, z);
+        
+        if(!write_render_chunk(model, faces, filepath))
+            return -1;
+        
+        num_bytes += file_size(filepath);
+        total_bytes += num_bytes;
+        
+        fprintf(index_file, "chunk %d %d %.9g %.9g %.9g %.9g %.9g %.9g %u\n", x, z,
+            mesh.bounds_min.x, mesh.bounds_min.y, mesh.bounds_min.z,
+            mesh.bounds_max.x, mesh.bounds_max.y, mesh.bounds_max.z,
+            num_bytes
+            );
+    }
+    
+    fclose(index_file);
+    
+    printf("%s%s: %u chunks of %g, %u triangles, %u bytes\n", directory, argv[2],
+        (unsigned int)cells.size(), chunk_size, (unsigned int)model.faces.size(), total_bytes);
+    
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "collisionmesh.h"
+
+//------------------------------------------------------------------
+// Name: write_float
+// Desc: Writes a float literal with enough digits to read back
+//       exactly, e.g. 0.0f, 1.25f, -3.5e-05f
+//------------------------------------------------------------------
+static void write_float(FILE *out, float f) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", f);
+    
+    // "0f" and "12f" aren't valid literals
+    if(!strpbrk(buf, ".e"))
+        strcat(buf, ".0");
+    
+    fprintf(out, "%sf", buf);
+}
+
+static void write_vec3(FILE *out, vec3 v) {
+    write_float(out, v.x);
+    fprintf(out, ", ");
+    write_float(out, v.y);
+    fprintf(out, ", ");
+    write_float(out, v.z);
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Cooks an OBJ model into a header that embeds its collision
+//       mesh (triangles in BVH order, and the BVH) as constexpr
+//       arrays, declaring an embedded_mesh called <name>.
+//
+//       Usage: obj2cpp <directory> <file> <name> <output header>
+//------------------------------------------------------------------
+int main(int argc, char **argv) {
+    if(argc < 5) {
+        printf("Usage: %s <directory> <file> <name> <output header>\n", argv[0]);
+        return -1;
+    }
+    
+    const char *name = argv[3];
+    
+    CollisionMesh mesh(argv[1], argv[2]);
+    
+    if(mesh.NumTriangles() == 0)
+        return -1;
+    
+    FILE *out = fopen(argv[4], "w");
+    
+    if(!out) {
+        printf("Could not open output file:\n%s\n", argv[4]);
+        return -1;
+    }
+    
+    fprintf(out, "// Generated by obj2cpp from %s%s. Do not edit\n", argv[1], argv[2]);
+    fprintf(out, "#pragma once\n\n#include \"embeddedmesh.h\"\n\n");
+    
+    fprintf(out, "static constexpr float %s_triangles[] = {\n", name);
+    
+    for(unsigned int i = 0; i < mesh.triangles.size(); i += 3) {
+        fprintf(out, "    ");
+        write_vec3(out, mesh.triangles[i]);
+        fprintf(out, ",  ");
+        write_vec3(out, mesh.triangles[i + 1]);
+        fprintf(out, ",  ");
+        write_vec3(out, mesh.triangles[i + 2]);
+        fprintf(out, ",\n");
+    }
+    
+    fprintf(out, "};\n\n");
+    
+    fprintf(out, "static constexpr embedded_bvh_node %s_nodes[] = {\n", name);
+    
+    for(unsigned int i = 0; i < mesh.nodes.size(); i++) {
+        const collision_bvh_node &node = mesh.nodes[i];
+        
+        fprintf(out, "    { { ");
+        write_vec3(out, node.bounds_min);
+        fprintf(out, " }, { ");
+        write_vec3(out, node.bounds_max);
+        fprintf(out, " }, %u, %u },\n", node.first, node.count);
+    }
+    
+    fprintf(out, "};\n\n");
+    
+    fprintf(out, "static constexpr embedded_mesh %s = {\n", name);
+    fprintf(out, "    %s_triangles, %u,\n", name, mesh.NumTriangles());
+    fprintf(out, "    %s_nodes, %u,\n", name, (unsigned int)mesh.nodes.size());
+    fprintf(out, "    { ");
+    write_vec3(out, mesh.bounds_min);
+    fprintf(out, " },\n    { ");
+    write_vec3(out, mesh.bounds_max);
+    fprintf(out, " }\n};\n");
+    
+    fclose(out);
+    
+    printf("%s: %u triangles, %u BVH nodes\n", name, mesh.NumTriangles(), (unsigned int)mesh.nodes.size());
+    
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <chrono>
+#include <cstdlib>
+
+#include "collisionmesh.h"
+#include "game.h"
+#include "replay.h"
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Headless replay playback. Re-simulates a recording made with
+//       `sphere-triangle-collision --record <file>` as fast as
+//       possible, without GLFW or OpenGL, and checks every frame's
+//       player position and state hash against the recording.
+//
+//       Usage: playback <file> [position tolerance]
+//       The default tolerance of 0 demands a bit-exact match.
+//       Stops at the first frame that diverges.
+//       Returns 0 if the replay matches, 1 if it diverged
+//------------------------------------------------------------------
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("Usage: %s <replay file> [position tolerance]\n", argv[0]);
+        return -1;
+    }
+    
+    float tolerance = argc > 2 ? (float)atof(argv[2]) : 0.0f;
+    
+    Replay replay(argv[1]);
+    
+    if(!replay.IsLoaded())
+        return -1;
+    
+    CollisionMesh terrain(replay.terrain_directory, replay.terrain_filename);
+    
+    if(terrain.NumTriangles() == 0)
+        return -1;
+    
+    Game game(&terrain);
+    
+    unsigned int num_frames = 0;
+    float max_error = 0.0f;
+    bool is_diverged = false;
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    for(unsigned int i = 0; i < replay.frames.size(); i++) {
+        const replay_frame &frame = replay.frames[i];
+        
+        game.Step(frame.input);
+        
+        float error = glm::length(game.player_pos - frame.player_pos);
+        max_error = fmaxf(max_error, error);
+        
+        num_frames++;
+        
+        // With no tolerance, every body must match bit for bit
+        bool hash_mismatch = game.StateHash() != frame.state_hash;
+        
+        if(error > tolerance || (tolerance == 0.0f && hash_mismatch)) {
+            printf("DIVERGED at frame %u: position error %g (tolerance %g), state hash %s\n",
+                i, error, tolerance, hash_mismatch ? "differs" : "matches");
+            is_diverged = true;
+            break;
+        }
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    printf("frames: %u of %u  time: %.3f ms  (%.0f frames/s)\n",
+        num_frames, (unsigned int)replay.frames.size(), seconds * 1000.0, num_frames / seconds);
+    printf("max position error: %g\n", max_error);
+    
+    if(is_diverged)
+        return 1;
+    
+    printf("OK\n");
+    
+    return 0;
+}
@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <glm/gtc/constants.hpp>
+
+#include "collisionmesh.h"
+#include "corerenderer.h"
+#include "fixedrenderer.h"
+#include "game.h"
+#include "skybox.h"
+#include "staticmesh.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+typedef struct {
+    double cpu_ms;   // Time to submit the frame
+    double frame_ms; // Time until the GPU finished it
+    
+    render_stats stats;
+} frame_sample;
+
+// Offscreen context
+EGLDisplay display;
+EGLContext context;
+EGLSurface surface;
+
+//------------------------------------------------------------
+// Name: context_init
+// Desc: Creates an offscreen OpenGL context on a pbuffer, using
+//       the Mesa surfaceless platform when it is available so no
+//       display server is needed
+//------------------------------------------------------------
+static bool context_init(bool core, int width, int height) {
+    display = EGL_NO_DISPLAY;
+    
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    
+    if(client_extensions != NULL && strstr(client_extensions, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        
+        if(eglGetPlatformDisplayEXT != NULL)
+            display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    
+    if(display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    
+    if(!eglInitialize(display, NULL, NULL)) {
+        printf("ERROR: Failed to initialize EGL!\n");
+        return false;
+    }
+    
+    eglBindAPI(EGL_OPENGL_API);
+    
+    EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    
+    EGLConfig config;
+    EGLint num_configs;
+    
+    if(!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs == 0) {
+        printf("ERROR: No suitable EGL config!\n");
+        return false;
+    }
+    
+    // Same context versions the demo asks GLFW for
+    EGLint core_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    
+    EGLint fixed_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 0,
+        EGL_NONE
+    };
+    
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, core ? core_attribs : fixed_attribs);
+    
+    EGLint surface_attribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    surface = eglCreatePbufferSurface(display, config, surface_attribs);
+    
+    if(context == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context)) {
+        printf("ERROR: Failed to create offscreen context (EGL error 0x%x)!\n", eglGetError());
+        return false;
+    }
+    
+    // Never wait for a vertical blank
+    eglSwapInterval(display, 0);
+    
+    // glewInit looks for a GLX display, which doesn't exist here
+    glewExperimental = GL_TRUE;
+    
+    if(glewContextInit() != GLEW_OK) {
+        printf("ERROR: Failed to initialize GLEW!\n");
+        return false;
+    }
+    
+    glGetError();
+    
+    printf("%s / %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    
+    return true;
+}
+
+//------------------------------------------------------------
+// Name: camera_path
+// Desc: Scripted camera for frame t in [0, 1): one lap around
+//       the level, swooping in towards the centre and out past
+//       the edges while bobbing between ground and roof height
+//------------------------------------------------------------
+static mat4 camera_path(const CollisionMesh &level, float t) {
+    vec3 center = (level.bounds_min + level.bounds_max) * 0.5f;
+    vec3 extent = level.bounds_max - level.bounds_min;
+    
+    float angle = 2.0f * glm::pi<float>() * t;
+    float radius = 0.5f * std::max(extent.x, extent.z) * (0.6f + 0.4f * cosf(2.0f * angle));
+    float height = level.bounds_min.y + 2.0f + 0.5f * extent.y * (0.5f + 0.5f * sinf(3.0f * angle));
+    
+    vec3 eye(center.x + radius * sinf(angle), height, center.z + radius * cosf(angle));
+    vec3 target(center.x, level.bounds_min.y + 0.25f * extent.y, center.z);
+    
+    return glm::lookAt(eye, target, vec3(0.0f, 1.0f, 0.0f));
+}
+
+//------------------------------------------------------------
+// Name: frame_checksum
+// Desc: FNV-1a hash of the frame's pixels
+//------------------------------------------------------------
+static unsigned int frame_checksum(int width, int height, std::vector<unsigned char>& pixels) {
+    pixels.resize(width * height * 4);
+    
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    
+    unsigned int hash = 2166136261u;
+    
+    for(unsigned int i = 0; i < pixels.size(); i++) {
+        hash ^= pixels[i];
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+//------------------------------------------------------------------
+// Name: main
+// Desc: Headless render benchmark. Renders a scripted camera path
+//       through a level in an offscreen context with no vsync and
+//       reports CPU frame times and the work submitted per frame.
+//
+//       Usage: renderbench [--renderer fixed|core] [--frames N]
+//                          [--warmup N] [--size WxH] [--checksum N]
+//                          [--csv <file>] [--level <dir> <file>]
+//       --checksum N prints a checksum of every Nth frame, so two
+//       runs (or two renderer changes) can be compared for identical
+//       output. Run from the repository root so data/ resolves
+//------------------------------------------------------------------
+int main(int argc, char **argv) {
+    bool use_core_renderer = false;
+    
+    unsigned int num_frames = 600;
+    unsigned int num_warmup_frames = 10;
+    unsigned int checksum_interval = 0;
+    
+    int width = 1280;
+    int height = 720;
+    
+    const char *csv_path = nullptr;
+    const char *level_directory = "data/Playground/";
+    const char *level_filename = "Playground.obj";
+    
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--renderer") && i + 1 < argc)
+            use_core_renderer = !strcmp(argv[++i], "core");
+        else if(!strcmp(argv[i], "--frames") && i + 1 < argc)
+            num_frames = (unsigned int)atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--warmup") && i + 1 < argc)
+            num_warmup_frames = (unsigned int)atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--size") && i + 1 < argc)
+            sscanf(argv[++i], "%dx%d", &width, &height);
+        else if(!strcmp(argv[i], "--checksum") && i + 1 < argc)
+            checksum_interval = (unsigned int)atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--csv") && i + 1 < argc)
+            csv_path = argv[++i];
+        else if(!strcmp(argv[i], "--level") && i + 2 < argc) {
+            level_directory = argv[++i];
+            level_filename = argv[++i];
+        }
+        else {
+            printf("Usage: %s [--renderer fixed|core] [--frames N] [--warmup N] [--size WxH]\n"
+                   "       [--checksum N] [--csv <file>] [--level <dir> <file>]\n", argv[0]);
+            return -1;
+        }
+    }
+    
+    if(num_frames == 0 || width <= 0 || height <= 0) {
+        printf("ERROR: Nothing to render!\n");
+        return -1;
+    }
+    
+    if(!context_init(use_core_renderer, width, height))
+        return -1;
+    
+    Renderer *renderer;
+    
+    if(use_core_renderer)
+        renderer = new CoreRenderer(width, height);
+    else
+        renderer = new FixedRenderer(width, height);
+    
+    Skybox *skybox = new Skybox("data/Skybox/");
+    StaticMesh *level_mesh = new StaticMesh(level_directory, level_filename);
+    CollisionMesh *level_collision = new CollisionMesh(level_directory, level_filename);
+    
+    if(level_collision->NumTriangles() == 0)
+        return -1;
+    
+    // The bodies settle under gravity while the camera flies around
+    Game *game = new Game(level_collision);
+    
+    game_input input;
+    input.buttons = 0;
+    input.mouse_dx = 0.0f;
+    input.mouse_dy = 0.0f;
+    
+    std::vector<sphere_instance> spheres;
+    std::vector<frame_sample> samples;
+    std::vector<unsigned char> pixels;
+    
+    unsigned int combined_checksum = 2166136261u;
+    
+    for(unsigned int frame = 0; frame < num_warmup_frames + num_frames; frame++) {
+        bool measured = frame >= num_warmup_frames;
+        unsigned int path_frame = measured ? frame - num_warmup_frames : 0;
+        
+        game->Step(input);
+        
+        const PhysicsWorld &world = game->world;
+        spheres.resize(world.NumBodies());
+        
+        for(unsigned int i = 0; i < world.NumBodies(); i++) {
+            spheres[i].position = world.GetPosition(i);
+            spheres[i].radius = world.radius[i];
+            spheres[i].color = i == game->player_body ? vec4(1.0f, 1.0f, 0.0f, 1.0f) : vec4(0.2f, 0.6f, 1.0f, 1.0f);
+        }
+        
+        mat4 view = camera_path(*level_collision, (float)path_frame / num_frames);
+        
+        auto start = std::chrono::steady_clock::now();
+        
+        renderer->BeginFrame(view);
+        renderer->DrawSkybox(skybox);
+        renderer->DrawSpheres(spheres.data(), (unsigned int)spheres.size());
+        renderer->DrawStaticMesh(level_mesh);
+        
+        auto submitted = std::chrono::steady_clock::now();
+        
+        glFinish();
+        
+        auto finished = std::chrono::steady_clock::now();
+        
+        if(!measured)
+            continue;
+        
+        frame_sample sample;
+        sample.cpu_ms = std::chrono::duration<double, std::milli>(submitted - start).count();
+        sample.frame_ms = std::chrono::duration<double, std::milli>(finished - start).count();
+        sample.stats = renderer->stats;
+        
+        samples.push_back(sample);
+        
+        if(checksum_interval > 0 && path_frame % checksum_interval == 0) {
+            unsigned int checksum = frame_checksum(width, height, pixels);
+            printf("frame %5u checksum %08x\n", path_frame, checksum);
+            
+            combined_checksum = (combined_checksum ^ checksum) * 16777619u;
+        }
+    }
+    
+    GLenum error = glGetError();
+    
+    if(error != GL_NO_ERROR)
+        printf("WARNING: OpenGL error 0x%x during the run\n", error);
+    
+    if(csv_path != nullptr) {
+        FILE *csv_file = fopen(csv_path, "w");
+        
+        if(!csv_file)
+            printf("Could not open CSV file:\n%s\n", csv_path);
+        else {
+            fprintf(csv_file, "frame,cpu_ms,frame_ms,draw_calls,state_changes,triangles\n");
+            
+            for(unsigned int i = 0; i < samples.size(); i++) {
+                fprintf(csv_file, "%u,%.4f,%.4f,%u,%u,%u\n", i, samples[i].cpu_ms, samples[i].frame_ms,
+                    samples[i].stats.draw_calls, samples[i].stats.state_changes, samples[i].stats.triangles);
+            }
+            
+            fclose(csv_file);
+        }
+    }
+    
+    // Summary
+    std::vector<double> cpu_times(samples.size());
+    
+    double total_cpu_ms = 0.0;
+    double total_frame_ms = 0.0;
+    double total_draw_calls = 0.0;
+    double total_state_changes = 0.0;
+    double total_triangles = 0.0;
+    
+    for(unsigned int i = 0; i < samples.size(); i++) {
+        cpu_times[i] = samples[i].cpu_ms;
+        
+        total_cpu_ms += samples[i].cpu_ms;
+        total_frame_ms += samples[i].frame_ms;
+        total_draw_calls += samples[i].stats.draw_calls;
+        total_state_changes += samples[i].stats.state_changes;
+        total_triangles += samples[i].stats.triangles;
+    }
+    
+    std::sort(cpu_times.begin(), cpu_times.end());
+    
+    unsigned int n = (unsigned int)samples.size();
+    
+    printf("renderer: %s  %dx%d  frames: %u\n", use_core_renderer ? "core" : "fixed", width, height, n);
+    printf("cpu frame time: mean %.3f ms  median %.3f ms  p95 %.3f ms  max %.3f ms\n",
+        total_cpu_ms / n, cpu_times[n / 2], cpu_times[(n * 95) / 100], cpu_times[n - 1]);
+    printf("frame time (to glFinish): mean %.3f ms  (%.1f frames/s)\n",
+        total_frame_ms / n, 1000.0 * n / total_frame_ms);
+    printf("per frame: %.1f draw calls  %.1f state changes  %.0f triangles\n",
+        total_draw_calls / n, total_state_changes / n, total_triangles / n);
+    
+    if(checksum_interval > 0)
+        printf("combined checksum %08x\n", combined_checksum);
+    
+    delete game;
+    delete level_collision;
+    delete level_mesh;
+    delete skybox;
+    delete renderer;
+    
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(display, surface);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    
+    return 0;
+}